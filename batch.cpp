@@ -0,0 +1,268 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#ifndef WIN32
+#include <glob.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+#include <sleep.h>
+
+#include "batch.h"
+#include "interpreter.h"
+
+enum BatchStatus {
+    BS_PENDING,
+    BS_RUNNING,  // if still in this state after the workers exit, the worker died
+    BS_OK,
+    BS_FAILED
+};
+
+// One per input, lives in memory shared between the parent and the workers.
+struct BatchSlot {
+    volatile int status;
+    double seconds;
+};
+
+// Header of the shared memory, followed by one BatchSlot per input.
+struct BatchShared {
+    volatile unsigned long next;
+};
+
+static BatchSlot *batch_slots (BatchShared *shared)
+{
+    return reinterpret_cast<BatchSlot*>(shared + 1);
+}
+
+static std::string trim (const std::string &s)
+{
+    const char *ws = " \t\r\n";
+    size_t b = s.find_first_not_of(ws);
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(ws);
+    return s.substr(b, e-b+1);
+}
+
+std::vector<std::string> batch_inputs (const std::string &each)
+{
+    std::vector<std::string> r;
+#ifndef WIN32
+    if (each.find_first_of("*?[") != std::string::npos) {
+        glob_t g;
+        int status = glob(each.c_str(), 0, NULL, &g);
+        if (status != 0 && status != GLOB_NOMATCH) {
+            std::cerr << "ERROR: Could not expand glob: \"" << each << "\"" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i=0 ; i<g.gl_pathc ; ++i) r.push_back(g.gl_pathv[i]);
+        globfree(&g);
+        return r;
+    }
+#endif
+    std::ifstream f(each.c_str());
+    if (!f.good()) {
+        std::cerr << "ERROR: Could not open list of inputs: \"" << each << "\"" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::string line;
+    while (std::getline(f, line)) {
+        line = trim(line);
+        if (line == "") continue;
+        r.push_back(line);
+    }
+    return r;
+}
+
+unsigned batch_default_jobs (void)
+{
+#ifdef WIN32
+    return 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : n;
+#endif
+}
+
+static void batch_one (const Work &work, const std::string &input, const std::vector<std::string> &args,
+                       BatchSlot &slot)
+{
+    std::vector<std::string> input_args;
+    input_args.push_back(input);
+    input_args.insert(input_args.end(), args.begin(), args.end());
+
+    slot.status = BS_RUNNING;
+    unsigned long long before = micros();
+
+    // A new interpreter each time, so one input cannot leak globals into the next.
+    interpreter_init();
+    bool ok = interpreter_exec_work(work, input_args);
+    interpreter_shutdown();
+
+    slot.seconds = (micros() - before) / 1E6;
+    slot.status = ok ? BS_OK : BS_FAILED;
+    if (!ok) {
+        std::cerr << "FAILED: " << input << std::endl;
+    }
+}
+
+static void batch_worker (const Work &work, const std::vector<std::string> &inputs,
+                          const std::vector<std::string> &args, BatchShared *shared)
+{
+    BatchSlot *slots = batch_slots(shared);
+    while (true) {
+        // Hand out inputs one at a time so that slow inputs do not hold up a whole worker's share.
+#ifdef WIN32
+        unsigned long i = shared->next++;
+#else
+        unsigned long i = __sync_fetch_and_add(&shared->next, 1);
+#endif
+        if (i >= inputs.size()) break;
+        batch_one(work, inputs[i], args, slots[i]);
+    }
+}
+
+static void batch_summary (const std::vector<std::string> &inputs, BatchShared *shared, unsigned jobs,
+                           double elapsed, unsigned long &failures)
+{
+    BatchSlot *slots = batch_slots(shared);
+    unsigned long ok = 0, failed = 0, crashed = 0, skipped = 0;
+    double total = 0;
+    std::vector<std::pair<double, unsigned long>> timings;
+    for (unsigned long i=0 ; i<inputs.size() ; ++i) {
+        switch (slots[i].status) {
+            case BS_OK: ok++; break;
+            case BS_FAILED: failed++; break;
+            case BS_RUNNING: crashed++; break;
+            default: skipped++;
+        }
+        if (slots[i].status == BS_OK || slots[i].status == BS_FAILED) {
+            total += slots[i].seconds;
+            timings.push_back(std::make_pair(slots[i].seconds, i));
+        }
+    }
+    failures = failed + crashed + skipped;
+
+    std::cerr << "Processed " << inputs.size() << " inputs with " << jobs << " jobs in " << elapsed << "s: "
+              << ok << " succeeded, " << failed << " failed, " << crashed << " crashed, "
+              << skipped << " not run." << std::endl;
+    if (timings.size() > 0) {
+        std::cerr << "Time per input: " << total / timings.size() << "s mean, " << total << "s total." << std::endl;
+        std::sort(timings.rbegin(), timings.rend());
+        std::cerr << "Slowest:" << std::endl;
+        for (unsigned long i=0 ; i<timings.size() && i<5 ; ++i) {
+            std::cerr << "    " << timings[i].first << "s  " << inputs[timings[i].second] << std::endl;
+        }
+    }
+    if (failed > 0) {
+        std::cerr << "Failed:" << std::endl;
+        for (unsigned long i=0 ; i<inputs.size() ; ++i) {
+            if (slots[i].status == BS_FAILED) std::cerr << "    " << inputs[i] << std::endl;
+        }
+    }
+    if (crashed > 0) {
+        std::cerr << "Crashed (the worker process died):" << std::endl;
+        for (unsigned long i=0 ; i<inputs.size() ; ++i) {
+            if (slots[i].status == BS_RUNNING) std::cerr << "    " << inputs[i] << std::endl;
+        }
+    }
+}
+
+unsigned long batch_run (const Work &work, const std::vector<std::string> &inputs,
+                         const std::vector<std::string> &args, unsigned jobs)
+{
+    if (inputs.size() == 0) {
+        std::cerr << "ERROR: No inputs to process." << std::endl;
+        return 1;
+    }
+    if (jobs < 1) jobs = 1;
+    if (jobs > inputs.size()) jobs = inputs.size();
+
+    size_t shared_size = sizeof(BatchShared) + inputs.size() * sizeof(BatchSlot);
+    unsigned long long before = micros();
+    unsigned long failures = 0;
+
+#ifdef WIN32
+    // No fork(), so run everything in this process.
+    std::vector<char> mem(shared_size);
+    BatchShared *shared = reinterpret_cast<BatchShared*>(&mem[0]);
+    shared->next = 0;
+    for (unsigned long i=0 ; i<inputs.size() ; ++i) batch_slots(shared)[i].status = BS_PENDING;
+    jobs = 1;
+    batch_worker(work, inputs, args, shared);
+    batch_summary(inputs, shared, jobs, (micros() - before) / 1E6, failures);
+#else
+    void *mem = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    BatchShared *shared = static_cast<BatchShared*>(mem);
+    shared->next = 0;
+    for (unsigned long i=0 ; i<inputs.size() ; ++i) batch_slots(shared)[i].status = BS_PENDING;
+
+    // Anything still buffered would otherwise be written once by every worker.
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(NULL);
+
+    std::vector<pid_t> workers;
+    for (unsigned j=0 ; j<jobs ; ++j) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("fork");
+            break;
+        }
+        if (pid == 0) {
+            batch_worker(work, inputs, args, shared);
+            std::cout.flush();
+            std::cerr.flush();
+            fflush(NULL);
+            _exit(EXIT_SUCCESS);
+        }
+        workers.push_back(pid);
+    }
+    if (workers.size() == 0) {
+        // Could not fork at all, do the work ourselves.
+        batch_worker(work, inputs, args, shared);
+    }
+    for (unsigned j=0 ; j<workers.size() ; ++j) {
+        int status;
+        while (waitpid(workers[j], &status, 0) == -1 && errno == EINTR) { }
+    }
+
+    batch_summary(inputs, shared, workers.size() == 0 ? 1 : workers.size(), (micros() - before) / 1E6, failures);
+    munmap(mem, shared_size);
+#endif
+
+    return failures;
+}
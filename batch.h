@@ -0,0 +1,46 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "interpreter.h"
+
+/** Expand the argument of --each into a list of inputs.  If it contains glob
+ * characters (*, ?, [) it is matched against the filesystem, otherwise it names
+ * a file containing one input per line. */
+std::vector<std::string> batch_inputs (const std::string &each);
+
+/** Execute the work once for every input, using the given number of worker
+ * processes.  Every invocation gets a fresh interpreter and receives the input as
+ * the first value of ..., followed by the usual commandline args.  A summary of
+ * timings and failures is written to stderr.  Returns the number of inputs that
+ * did not complete successfully. */
+unsigned long batch_run (const Work &work, const std::vector<std::string> &inputs,
+                         const std::vector<std::string> &args, unsigned jobs);
+
+/** A sensible default for the number of worker processes (the number of cores). */
+unsigned batch_default_jobs (void);
+
+#endif
@@ -0,0 +1,151 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstddef>
+
+#include <algorithm>
+#include <vector>
+
+#include <exception.h>
+
+#include "blur.h"
+#include "parallel.h"
+
+namespace {
+
+    // Mean of the 2r+1 pixels around each pixel of a line of n-channel pixels.  The channel
+    // count is a template parameter so the inner loops unroll (and vectorise) across channels.
+    // Sums are kept in double so that they do not drift over long lines.
+    template<chan_t n> void box_line (const float *in, float *out, size_t len, size_t r, bool wrap)
+    {
+        ptrdiff_t slen = len;
+        auto at = [&] (ptrdiff_t j) -> const float * {
+            if (wrap) {
+                j %= slen;
+                if (j < 0) j += slen;
+            } else {
+                j = j < 0 ? 0 : j >= slen ? slen - 1 : j;
+            }
+            return &in[j * n];
+        };
+        double acc[n];
+        for (chan_t c=0 ; c<n ; ++c) acc[c] = 0;
+        ptrdiff_t sr = r;
+        for (ptrdiff_t j=-sr ; j<=sr ; ++j) {
+            const float *p = at(j);
+            for (chan_t c=0 ; c<n ; ++c) acc[c] += p[c];
+        }
+        double inv = 1.0 / (2*r + 1);
+        for (ptrdiff_t i=0 ; i<slen ; ++i) {
+            for (chan_t c=0 ; c<n ; ++c) out[i*n + c] = acc[c] * inv;
+            const float *add = at(i + sr + 1);
+            const float *sub = at(i - sr);
+            for (chan_t c=0 ; c<n ; ++c) acc[c] += add[c] - sub[c];
+        }
+    }
+
+    // Run the box passes with radii rx along each row, then ry along each column.  Each line is
+    // copied into a contiguous buffer so all of its passes happen in cache.
+    template<chan_t n> void box_passes (float *data, uimglen_t width, uimglen_t height,
+                                        const std::vector<size_t> &rx, const std::vector<size_t> &ry,
+                                        bool wrap_x, bool wrap_y)
+    {
+        if (width == 0 || height == 0) return;
+
+        if (!rx.empty()) parallel_for(height, width * n * rx.size(), [&] (size_t begin, size_t end) {
+            std::vector<float> a(size_t(width) * n), b(size_t(width) * n);
+            for (size_t y=begin ; y<end ; ++y) {
+                float *row = &data[y * width * n];
+                std::copy(row, row + a.size(), a.begin());
+                for (size_t r : rx) {
+                    box_line<n>(&a[0], &b[0], width, r, wrap_x);
+                    a.swap(b);
+                }
+                std::copy(a.begin(), a.end(), row);
+            }
+        });
+
+        if (!ry.empty()) parallel_for(width, height * n * ry.size(), [&] (size_t begin, size_t end) {
+            std::vector<float> a(size_t(height) * n), b(size_t(height) * n);
+            for (size_t x=begin ; x<end ; ++x) {
+                for (size_t y=0 ; y<height ; ++y)
+                    for (chan_t c=0 ; c<n ; ++c) a[y*n + c] = data[(y*width + x)*n + c];
+                for (size_t r : ry) {
+                    box_line<n>(&a[0], &b[0], height, r, wrap_y);
+                    a.swap(b);
+                }
+                for (size_t y=0 ; y<height ; ++y)
+                    for (chan_t c=0 ; c<n ; ++c) data[(y*width + x)*n + c] = a[y*n + c];
+            }
+        });
+    }
+
+    ImageBase *blur (const ImageBase *src, const std::vector<size_t> &rx,
+                     const std::vector<size_t> &ry, bool wrap_x, bool wrap_y)
+    {
+        ImageBase *r = src->clone(false, false);
+        float *data = r->raw();
+        switch (r->channels()) {
+            case 1: box_passes<1>(data, r->width, r->height, rx, ry, wrap_x, wrap_y); break;
+            case 2: box_passes<2>(data, r->width, r->height, rx, ry, wrap_x, wrap_y); break;
+            case 3: box_passes<3>(data, r->width, r->height, rx, ry, wrap_x, wrap_y); break;
+            case 4: box_passes<4>(data, r->width, r->height, rx, ry, wrap_x, wrap_y); break;
+            default:
+            delete r;
+            EXCEPTEX << "Unsupported number of channels: " << int(src->channels()) << ENDL;
+        }
+        return r;
+    }
+
+    // Radii of 3 successive box filters whose combined variance best approximates sigma^2.
+    std::vector<size_t> gaussian_radii (float sigma)
+    {
+        const int passes = 3;
+        double ideal = std::sqrt(12.0 * sigma * sigma / passes + 1);
+        int lower = int(std::floor(ideal));
+        if (lower % 2 == 0) lower--;
+        int upper = lower + 2;
+        double m = (12.0 * sigma * sigma - passes * lower * lower - 4.0 * passes * lower - 3.0 * passes)
+                 / (-4.0 * lower - 4.0);
+        int lower_passes = int(std::lround(m));
+        std::vector<size_t> r;
+        for (int i=0 ; i<passes ; ++i) {
+            size_t radius = ((i < lower_passes ? lower : upper) - 1) / 2;
+            if (radius > 0) r.push_back(radius);
+        }
+        return r;
+    }
+
+}
+
+ImageBase *box_blur (const ImageBase *src, uimglen_t rx, uimglen_t ry, bool wrap_x, bool wrap_y)
+{
+    std::vector<size_t> rxs, rys;
+    if (rx > 0) rxs.push_back(rx);
+    if (ry > 0) rys.push_back(ry);
+    return blur(src, rxs, rys, wrap_x, wrap_y);
+}
+
+ImageBase *fast_gaussian (const ImageBase *src, float sigma_x, float sigma_y, bool wrap_x, bool wrap_y)
+{
+    return blur(src, gaussian_radii(sigma_x), gaussian_radii(sigma_y), wrap_x, wrap_y);
+}
@@ -0,0 +1,39 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef BLUR_H
+#define BLUR_H
+
+#include "image.h"
+
+/** Each pixel becomes the mean of the (2*rx+1) by (2*ry+1) box centred on it.
+ * Beyond the edges, the edge pixels are repeated or the image wraps around, as
+ * in convolve.  Computed with running sums, so the cost does not depend on the
+ * radius. */
+ImageBase *box_blur (const ImageBase *src, uimglen_t rx, uimglen_t ry, bool wrap_x, bool wrap_y);
+
+/** Approximate Gaussian blur with the given standard deviation (in pixels) in
+ * each axis.  Three box blurs of sizes chosen to match the Gaussian's variance
+ * (Kovesi, "Fast Almost-Gaussian Filtering"), so as with box_blur the cost does
+ * not depend on sigma. */
+ImageBase *fast_gaussian (const ImageBase *src, float sigma_x, float sigma_y, bool wrap_x, bool wrap_y);
+
+#endif
@@ -0,0 +1,199 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstdlib>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <exception.h>
+
+#include "colour_lut.h"
+#include "parallel.h"
+
+namespace {
+
+    // Position of v in a table of size entries covering lo to hi: the index of the entry below
+    // and the fraction of the way to the next one.  Clamped to the table.
+    void locate (float v, float lo, float hi, unsigned size, unsigned &i, float &f)
+    {
+        float x = (v - lo) / (hi - lo) * (size - 1);
+        if (!(x > 0)) x = 0;
+        if (x > size - 1) x = size - 1;
+        i = std::min(unsigned(x), size - 2);
+        f = x - i;
+    }
+
+    template<chan_t n> void apply_n (const ColourLut &lut, LutInterpolation interp,
+                                     const float *in, float *out, uimglen_t w, uimglen_t h)
+    {
+        const unsigned s = lut.size3d;
+        const size_t sg = size_t(s) * 3, sb = size_t(s) * s * 3;
+        parallel_for(h, size_t(w) * 32, [&] (size_t begin, size_t end) {
+            for (size_t i=begin*w ; i<end*w ; ++i) {
+                const float *p = &in[i * n];
+                float *o = &out[i * n];
+                float c[3] = { p[0], p[1], p[2] };
+                if (lut.size1d > 0) {
+                    for (int k=0 ; k<3 ; ++k) {
+                        unsigned idx;
+                        float f;
+                        locate(c[k], lut.domain1dMin[k], lut.domain1dMax[k], lut.size1d, idx, f);
+                        const float *e = &lut.shaper[idx * 3 + k];
+                        c[k] = e[0] + (e[3] - e[0]) * f;
+                    }
+                }
+                if (s > 0) {
+                    unsigned ir, ig, ib;
+                    float fr, fg, fb;
+                    locate(c[0], lut.domain3dMin[0], lut.domain3dMax[0], s, ir, fr);
+                    locate(c[1], lut.domain3dMin[1], lut.domain3dMax[1], s, ig, fg);
+                    locate(c[2], lut.domain3dMin[2], lut.domain3dMax[2], s, ib, fb);
+                    // Corner cRGB is offset by R in red, G in green, B in blue.
+                    const float *c000 = &lut.table[ib * sb + ig * sg + ir * 3];
+                    const float *c100 = c000 + 3, *c010 = c000 + sg, *c110 = c010 + 3;
+                    const float *c001 = c000 + sb, *c101 = c001 + 3, *c011 = c001 + sg, *c111 = c011 + 3;
+                    if (interp == LUT_TRILINEAR) {
+                        for (int k=0 ; k<3 ; ++k) {
+                            float x00 = c000[k] + (c100[k] - c000[k]) * fr;
+                            float x10 = c010[k] + (c110[k] - c010[k]) * fr;
+                            float x01 = c001[k] + (c101[k] - c001[k]) * fr;
+                            float x11 = c011[k] + (c111[k] - c011[k]) * fr;
+                            float y0 = x00 + (x10 - x00) * fg;
+                            float y1 = x01 + (x11 - x01) * fg;
+                            c[k] = y0 + (y1 - y0) * fb;
+                        }
+                    } else {
+                        // The cell splits into 6 tetrahedra along its grey diagonal, chosen by
+                        // the order of the fractions; the result is then a blend of 4 corners.
+                        const float *a, *b;
+                        float w0, w1, w2, w3;
+                        if (fr > fg) {
+                            if (fg > fb) {
+                                a = c100; b = c110; w0 = 1 - fr; w1 = fr - fg; w2 = fg - fb; w3 = fb;
+                            } else if (fr > fb) {
+                                a = c100; b = c101; w0 = 1 - fr; w1 = fr - fb; w2 = fb - fg; w3 = fg;
+                            } else {
+                                a = c001; b = c101; w0 = 1 - fb; w1 = fb - fr; w2 = fr - fg; w3 = fg;
+                            }
+                        } else {
+                            if (fb > fg) {
+                                a = c001; b = c011; w0 = 1 - fb; w1 = fb - fg; w2 = fg - fr; w3 = fr;
+                            } else if (fb > fr) {
+                                a = c010; b = c011; w0 = 1 - fg; w1 = fg - fb; w2 = fb - fr; w3 = fr;
+                            } else {
+                                a = c010; b = c110; w0 = 1 - fg; w1 = fg - fr; w2 = fr - fb; w3 = fb;
+                            }
+                        }
+                        for (int k=0 ; k<3 ; ++k)
+                            c[k] = w0 * c000[k] + w1 * a[k] + w2 * b[k] + w3 * c111[k];
+                    }
+                }
+                o[0] = c[0];
+                o[1] = c[1];
+                o[2] = c[2];
+                for (chan_t k=3 ; k<n ; ++k) o[k] = p[k];
+            }
+        });
+    }
+
+}
+
+ColourLut::ColourLut (const std::string &filename)
+  : size1d(0), size3d(0)
+{
+    for (int k=0 ; k<3 ; ++k) {
+        domain1dMin[k] = domain3dMin[k] = 0;
+        domain1dMax[k] = domain3dMax[k] = 1;
+    }
+    std::ifstream f(filename.c_str());
+    if (!f.good()) EXCEPT << "Could not open LUT file: \"" << filename << "\"" << ENDL;
+
+    std::vector<float> data;
+    std::string line;
+    unsigned line_num = 0;
+    while (std::getline(f, line)) {
+        line_num++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream ss(line);
+        std::string key;
+        if (!(ss >> key)) continue;
+        bool bad = false;
+        if (key == "TITLE") {
+            size_t q0 = line.find('"'), q1 = line.rfind('"');
+            if (q0 != std::string::npos && q1 > q0) title = line.substr(q0 + 1, q1 - q0 - 1);
+        } else if (key == "LUT_1D_SIZE") {
+            bad = !(ss >> size1d) || size1d < 2 || size1d > 65536;
+        } else if (key == "LUT_3D_SIZE") {
+            bad = !(ss >> size3d) || size3d < 2 || size3d > 256;
+        } else if (key == "DOMAIN_MIN") {
+            for (int k=0 ; k<3 ; ++k) bad = bad || !(ss >> domain1dMin[k]);
+            std::copy(domain1dMin, domain1dMin + 3, domain3dMin);
+        } else if (key == "DOMAIN_MAX") {
+            for (int k=0 ; k<3 ; ++k) bad = bad || !(ss >> domain1dMax[k]);
+            std::copy(domain1dMax, domain1dMax + 3, domain3dMax);
+        } else if (key == "LUT_1D_INPUT_RANGE" || key == "LUT_3D_INPUT_RANGE") {
+            float lo, hi;
+            bad = !(ss >> lo >> hi);
+            float *mn = key == "LUT_1D_INPUT_RANGE" ? domain1dMin : domain3dMin;
+            float *mx = key == "LUT_1D_INPUT_RANGE" ? domain1dMax : domain3dMax;
+            std::fill(mn, mn + 3, lo);
+            std::fill(mx, mx + 3, hi);
+        } else if ((key[0] >= 'A' && key[0] <= 'Z') || (key[0] >= 'a' && key[0] <= 'z')) {
+            // Other keywords (e.g. LUT_IN_VIDEO_RANGE) do not change the table.
+        } else {
+            float v[3];
+            v[0] = strtof(key.c_str(), NULL);
+            bad = !(ss >> v[1] >> v[2]);
+            data.insert(data.end(), v, v + 3);
+        }
+        if (bad) EXCEPT << "In \"" << filename << "\" line " << line_num << ": could not parse \"" << line << "\"" << ENDL;
+    }
+
+    if (size1d == 0 && size3d == 0)
+        EXCEPT << "In \"" << filename << "\": no LUT_1D_SIZE or LUT_3D_SIZE." << ENDL;
+    for (int k=0 ; k<3 ; ++k) {
+        if (!(domain1dMax[k] > domain1dMin[k]) || !(domain3dMax[k] > domain3dMin[k]))
+            EXCEPT << "In \"" << filename << "\": empty domain." << ENDL;
+    }
+    size_t expected = size_t(size1d) * 3 + size_t(size3d) * size3d * size3d * 3;
+    if (data.size() != expected)
+        EXCEPT << "In \"" << filename << "\": expected " << expected / 3 << " entries, got " << data.size() / 3 << ENDL;
+    // A shaper comes first when both are present.
+    shaper.assign(data.begin(), data.begin() + size_t(size1d) * 3);
+    table.assign(data.begin() + size_t(size1d) * 3, data.end());
+}
+
+ImageBase *ColourLut::apply (const ImageBase *src, LutInterpolation interp) const
+{
+    if (src->colourChannels() != 3)
+        EXCEPTEX << "Colour LUTs need an image with 3 colour channels, got " << int(src->colourChannels()) << ENDL;
+    ImageBase *dst = image_alloc(src->width, src->height, src->channels(), src->hasAlpha());
+    if (src->hasAlpha()) {
+        apply_n<4>(*this, interp, src->raw(), dst->raw(), src->width, src->height);
+    } else {
+        apply_n<3>(*this, interp, src->raw(), dst->raw(), src->width, src->height);
+    }
+    return dst;
+}
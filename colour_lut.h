@@ -0,0 +1,74 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef COLOUR_LUT_H
+#define COLOUR_LUT_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "image.h"
+
+enum LutInterpolation {
+    LUT_TRILINEAR,
+    LUT_TETRAHEDRAL
+};
+
+/** A colour grading lookup table, as read from a .cube file: an optional 1D shaper applied to
+ * each channel, then an optional 3D table (at least one of the two is present). */
+class ColourLut {
+
+    public:
+
+    std::string title;
+
+    /** size1d entries of RGB, mapping domain1dMin to domain1dMax. */
+    unsigned size1d;
+    std::vector<float> shaper;
+    float domain1dMin[3], domain1dMax[3];
+
+    /** size3d cubed entries of RGB, red varying fastest, mapping domain3dMin to domain3dMax. */
+    unsigned size3d;
+    std::vector<float> table;
+    float domain3dMin[3], domain3dMax[3];
+
+    /** Parse a .cube file (the Adobe / Resolve format), throwing on errors. */
+    ColourLut (const std::string &filename);
+
+    size_t numBytes (void) const { return (shaper.size() + table.size()) * sizeof(float); }
+
+    /** Grade the colour channels of src (which must have 3), leaving any alpha alone.  Values
+     * outside a table's domain are clamped to it.  Tetrahedral interpolation reads 4 of the 8
+     * corners of the enclosing cell and keeps the grey axis exactly on the table's greys. */
+    ImageBase *apply (const ImageBase *src, LutInterpolation interp) const;
+};
+
+static inline std::ostream &operator<<(std::ostream &o, const ColourLut &lut)
+{
+    o << "ColourLut (";
+    if (lut.size1d > 0) o << "1D " << lut.size1d << (lut.size3d > 0 ? ", " : "");
+    if (lut.size3d > 0) o << "3D " << lut.size3d;
+    o << ") [0x" << &lut << "]";
+    return o;
+}
+
+#endif
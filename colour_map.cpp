@@ -0,0 +1,264 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <algorithm>
+
+#include <exception.h>
+
+#include "colour_map.h"
+#include "parallel.h"
+
+namespace {
+
+    // Index of the table entry below v and the fraction of the way to the next one, where lo maps
+    // to the first entry and scale is the number of entries per unit.
+    inline unsigned locate (float v, float lo, float scale, float &f)
+    {
+        float x = (v - lo) * scale;
+        if (!(x > 0)) x = 0;
+        if (x > COLOUR_TABLE_SIZE - 1) x = COLOUR_TABLE_SIZE - 1;
+        unsigned i = std::min(unsigned(x), COLOUR_TABLE_SIZE - 2);
+        f = x - i;
+        return i;
+    }
+
+    template<chan_t m> void map_rows (const ColourTable &table, float lo, float scale,
+                                      const float *in, chan_t in_ch, float *out, chan_t out_ch,
+                                      uimglen_t w, uimglen_t h)
+    {
+        // Which output channel the source's alpha goes to (out_ch if nowhere).
+        const chan_t alpha_to = in_ch == 2 && (table.alpha || out_ch > m) ? out_ch - 1 : out_ch;
+        const float *t = &table.data[0];
+        parallel_for(h, size_t(w) * 8, [&] (size_t begin, size_t end) {
+            for (size_t i=begin*w ; i<end*w ; ++i) {
+                float f;
+                const float *e = &t[locate(in[i * in_ch], lo, scale, f) * m];
+                float *o = &out[i * out_ch];
+                for (chan_t k=0 ; k<m ; ++k) o[k] = e[k] + (e[k + m] - e[k]) * f;
+                if (alpha_to < m) {
+                    o[alpha_to] *= in[i * in_ch + 1];
+                } else if (alpha_to < out_ch) {
+                    o[alpha_to] = in[i * in_ch + 1];
+                }
+            }
+        });
+    }
+
+    template<chan_t n> void curve_rows (const ColourTable &table, float lo, float scale,
+                                        chan_t colour_channels, const float *in, float *out,
+                                        uimglen_t w, uimglen_t h)
+    {
+        const float *t = &table.data[0];
+        parallel_for(h, size_t(w) * n * 8, [&] (size_t begin, size_t end) {
+            for (size_t i=begin*w*n ; i<end*w*n ; i+=n) {
+                for (chan_t k=0 ; k<n ; ++k) {
+                    if (k < colour_channels) {
+                        float f;
+                        const float *e = &t[locate(in[i + k], lo, scale, f)];
+                        out[i + k] = e[0] + (e[1] - e[0]) * f;
+                    } else {
+                        out[i + k] = in[i + k];
+                    }
+                }
+            }
+        });
+    }
+
+    // Slopes of the curve at each point, for Hermite interpolation between them.
+    std::vector<float> curve_slopes (const std::vector<float> &xs, const std::vector<float> &ys,
+                                     CurveInterp interp)
+    {
+        size_t sz = xs.size();
+        std::vector<float> d(sz - 1), m(sz, 0);
+        for (size_t k=0 ; k<sz-1 ; ++k) d[k] = (ys[k+1] - ys[k]) / (xs[k+1] - xs[k]);
+        if (interp == CURVE_CUBIC) {
+            // Natural spline: solve the tridiagonal system for the second derivatives (zero at
+            // the ends), then convert them to slopes.
+            std::vector<double> c(sz, 0), r(sz, 0), dd(sz, 0);
+            for (size_t k=1 ; k<sz-1 ; ++k) {
+                double h0 = xs[k] - xs[k-1], h1 = xs[k+1] - xs[k];
+                double diag = 2 * (h0 + h1) - h0 * c[k-1];
+                c[k] = h1 / diag;
+                r[k] = (6 * (d[k] - d[k-1]) - h0 * r[k-1]) / diag;
+            }
+            for (size_t k=sz-2 ; k>0 ; --k) dd[k] = r[k] - c[k] * dd[k+1];
+            for (size_t k=0 ; k<sz-1 ; ++k) {
+                double h = xs[k+1] - xs[k];
+                m[k] = d[k] - h * (2 * dd[k] + dd[k+1]) / 6;
+            }
+            double h = xs[sz-1] - xs[sz-2];
+            m[sz-1] = d[sz-2] + h * (dd[sz-2] + 2 * dd[sz-1]) / 6;
+        } else {
+            // Fritsch-Carlson.
+            m[0] = d[0];
+            m[sz-1] = d[sz-2];
+            for (size_t k=1 ; k<sz-1 ; ++k)
+                m[k] = d[k-1] * d[k] > 0 ? (d[k-1] + d[k]) / 2 : 0;
+            for (size_t k=0 ; k<sz-1 ; ++k) {
+                if (d[k] == 0) {
+                    m[k] = m[k+1] = 0;
+                    continue;
+                }
+                float a = m[k] / d[k], b = m[k+1] / d[k];
+                float s = a*a + b*b;
+                if (s > 9) {
+                    float t = 3 / sqrtf(s);
+                    m[k] = t * a * d[k];
+                    m[k+1] = t * b * d[k];
+                }
+            }
+        }
+        return m;
+    }
+
+}
+
+ColourTable colour_table_from_image (const ImageBase *gradient)
+{
+    if (gradient->width == 0 || gradient->height == 0) EXCEPTEX << "Gradient image is empty." << ENDL;
+    ColourTable r;
+    r.channels = gradient->channels();
+    r.alpha = gradient->hasAlpha();
+    r.data.resize(COLOUR_TABLE_SIZE * r.channels);
+    const float *row = gradient->raw();
+    uimglen_t w = gradient->width;
+    for (unsigned i=0 ; i<COLOUR_TABLE_SIZE ; ++i) {
+        float x = float(i) / (COLOUR_TABLE_SIZE - 1) * (w - 1);
+        uimglen_t x0 = std::min(uimglen_t(x), w > 1 ? w - 2 : 0);
+        uimglen_t x1 = std::min(x0 + 1, w - 1);
+        float f = x - x0;
+        for (chan_t k=0 ; k<r.channels ; ++k) {
+            float a = row[x0 * r.channels + k], b = row[x1 * r.channels + k];
+            r.data[i * r.channels + k] = a + (b - a) * f;
+        }
+    }
+    return r;
+}
+
+ColourTable colour_table_from_stops (const std::vector<float> &positions,
+                                     const std::vector<float> &colours, chan_t channels)
+{
+    size_t sz = positions.size();
+    if (sz == 0) EXCEPTEX << "No gradient stops." << ENDL;
+    for (size_t k=1 ; k<sz ; ++k) {
+        if (!(positions[k] >= positions[k-1]))
+            EXCEPTEX << "Gradient stop positions must be increasing." << ENDL;
+    }
+    ColourTable r;
+    r.channels = channels;
+    r.alpha = false;
+    r.data.resize(COLOUR_TABLE_SIZE * channels);
+    size_t seg = 0;
+    for (unsigned i=0 ; i<COLOUR_TABLE_SIZE ; ++i) {
+        float t = float(i) / (COLOUR_TABLE_SIZE - 1);
+        while (seg < sz && positions[seg] <= t) seg++;
+        // Stops seg-1 and seg enclose t.
+        for (chan_t k=0 ; k<channels ; ++k) {
+            float v;
+            if (seg == 0) {
+                v = colours[k];
+            } else if (seg == sz) {
+                v = colours[(sz - 1) * channels + k];
+            } else {
+                float p0 = positions[seg-1], p1 = positions[seg];
+                float a = colours[(seg-1) * channels + k], b = colours[seg * channels + k];
+                v = a + (b - a) * (t - p0) / (p1 - p0);
+            }
+            r.data[i * channels + k] = v;
+        }
+    }
+    return r;
+}
+
+ImageBase *colour_map (const ImageBase *src, const ColourTable &table, float lo, float hi)
+{
+    if (src->colourChannels() != 1)
+        EXCEPTEX << "Colour maps need an image with 1 colour channel, got " << int(src->colourChannels()) << ENDL;
+    if (!(hi != lo)) EXCEPTEX << "Colour map range is empty." << ENDL;
+    chan_t out_ch = table.channels;
+    bool out_alpha = table.alpha;
+    if (src->hasAlpha() && !table.alpha && table.channels < 4) {
+        out_ch++;
+        out_alpha = true;
+    }
+    ImageBase *dst = image_alloc(src->width, src->height, out_ch, out_alpha);
+    float scale = (COLOUR_TABLE_SIZE - 1) / (hi - lo);
+    const float *in = src->raw();
+    float *out = dst->raw();
+    chan_t in_ch = src->channels();
+    switch (table.channels) {
+        case 1: map_rows<1>(table, lo, scale, in, in_ch, out, out_ch, src->width, src->height); break;
+        case 2: map_rows<2>(table, lo, scale, in, in_ch, out, out_ch, src->width, src->height); break;
+        case 3: map_rows<3>(table, lo, scale, in, in_ch, out, out_ch, src->width, src->height); break;
+        case 4: map_rows<4>(table, lo, scale, in, in_ch, out, out_ch, src->width, src->height); break;
+        default: EXCEPTEX << "Internal error: weird channels " << int(table.channels) << ENDL;
+    }
+    return dst;
+}
+
+ImageBase *curve (const ImageBase *src, const std::vector<float> &xs, const std::vector<float> &ys,
+                  CurveInterp interp)
+{
+    size_t sz = xs.size();
+    if (sz < 2 || ys.size() != sz) EXCEPTEX << "A curve needs at least 2 points." << ENDL;
+    for (size_t k=1 ; k<sz ; ++k) {
+        if (!(xs[k] > xs[k-1])) EXCEPTEX << "Curve points must be increasing in x." << ENDL;
+    }
+
+    std::vector<float> m;
+    if (interp != CURVE_LINEAR) m = curve_slopes(xs, ys, interp);
+    ColourTable table;
+    table.channels = 1;
+    table.alpha = false;
+    table.data.resize(COLOUR_TABLE_SIZE);
+    float lo = xs[0], hi = xs[sz-1];
+    size_t seg = 0;
+    for (unsigned i=0 ; i<COLOUR_TABLE_SIZE ; ++i) {
+        float x = lo + (hi - lo) * i / (COLOUR_TABLE_SIZE - 1);
+        while (seg < sz - 2 && xs[seg+1] <= x) seg++;
+        float h = xs[seg+1] - xs[seg];
+        float t = std::min(std::max((x - xs[seg]) / h, 0.0f), 1.0f);
+        float y0 = ys[seg], y1 = ys[seg+1];
+        if (interp == CURVE_LINEAR) {
+            table.data[i] = y0 + (y1 - y0) * t;
+        } else {
+            float t2 = t * t, t3 = t2 * t;
+            table.data[i] = (2*t3 - 3*t2 + 1) * y0 + (t3 - 2*t2 + t) * h * m[seg]
+                          + (-2*t3 + 3*t2) * y1 + (t3 - t2) * h * m[seg+1];
+        }
+    }
+
+    ImageBase *dst = image_alloc(src->width, src->height, src->channels(), src->hasAlpha());
+    float scale = (COLOUR_TABLE_SIZE - 1) / (hi - lo);
+    const float *in = src->raw();
+    float *out = dst->raw();
+    chan_t cc = src->colourChannels();
+    switch (src->channels()) {
+        case 1: curve_rows<1>(table, lo, scale, cc, in, out, src->width, src->height); break;
+        case 2: curve_rows<2>(table, lo, scale, cc, in, out, src->width, src->height); break;
+        case 3: curve_rows<3>(table, lo, scale, cc, in, out, src->width, src->height); break;
+        case 4: curve_rows<4>(table, lo, scale, cc, in, out, src->width, src->height); break;
+        default: EXCEPTEX << "Internal error: weird channels " << int(src->channels()) << ENDL;
+    }
+    return dst;
+}
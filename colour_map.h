@@ -0,0 +1,69 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef COLOUR_MAP_H
+#define COLOUR_MAP_H
+
+#include <vector>
+
+#include "image.h"
+
+enum CurveInterp {
+    CURVE_LINEAR,
+    CURVE_CUBIC,
+    CURVE_MONOTONE
+};
+
+/** A function of one variable baked into COLOUR_TABLE_SIZE evenly spaced entries, each of
+ * channels floats (the last being alpha if alpha is set), between which lookups interpolate
+ * linearly.  The 4096 steps put power of 2 fractions of the range exactly on entries. */
+struct ColourTable {
+    chan_t channels;
+    bool alpha;
+    std::vector<float> data;
+};
+
+static const unsigned COLOUR_TABLE_SIZE = 4097;
+
+/** Bake the bottom row of a gradient image, from the centre of its first pixel to the centre of
+ * its last.  Throws if the image is empty. */
+ColourTable colour_table_from_image (const ImageBase *gradient);
+
+/** Bake a piecewise linear gradient through the given stops, positions between 0 and 1 in
+ * increasing order and channels floats of colour for each.  Beyond the first and last stops
+ * their colours are held. */
+ColourTable colour_table_from_stops (const std::vector<float> &positions,
+                                     const std::vector<float> &colours, chan_t channels);
+
+/** Map each pixel of an image with one colour channel through the table, lo giving its first
+ * entry and hi its last (values beyond are clamped).  The result has the table's channels.  An
+ * alpha channel of src is multiplied into the table's alpha, or appended if the table has none
+ * and fewer than 4 channels. */
+ImageBase *colour_map (const ImageBase *src, const ColourTable &table, float lo, float hi);
+
+/** Pass each colour channel of src through the curve interpolating the given points (increasing
+ * in x), leaving alpha alone.  CUBIC is a natural cubic spline, as in the curves tools of image
+ * editors, and MONOTONE a Fritsch-Carlson spline that never overshoots between points.  Beyond
+ * the first and last points, their y values are held. */
+ImageBase *curve (const ImageBase *src, const std::vector<float> &xs, const std::vector<float> &ys,
+                  CurveInterp interp);
+
+#endif
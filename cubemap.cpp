@@ -0,0 +1,341 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <memory>
+
+#include <exception.h>
+
+#include "cubemap.h"
+#include "parallel.h"
+#include "sampler.h"
+
+namespace {
+
+    // Face and the position (0 to 1) on it that a direction (not necessarily normalised) hits.
+    // This is cube_direction solved for px and py.
+    void cube_lookup (const float *d, unsigned &face, float &u, float &v)
+    {
+        float ax = std::fabs(d[0]), ay = std::fabs(d[1]), az = std::fabs(d[2]);
+        float px, py, ma;
+        if (ax >= ay && ax >= az) {
+            ma = ax;
+            face = d[0] > 0 ? 0 : 1;
+            px = d[0] > 0 ? -d[2] : d[2];
+            py = -d[1];
+        } else if (ay >= az) {
+            ma = ay;
+            face = d[1] > 0 ? 2 : 3;
+            px = -d[0];
+            py = d[1] > 0 ? d[2] : -d[2];
+        } else {
+            ma = az;
+            face = d[2] > 0 ? 4 : 5;
+            px = d[2] > 0 ? d[0] : -d[0];
+            py = -d[1];
+        }
+        if (!(ma > 0)) ma = 1;
+        u = 0.5f * (px / ma + 1);
+        v = 0.5f * (py / ma + 1);
+    }
+
+    void normalise (float *d)
+    {
+        float l = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        for (int i=0 ; i<3 ; ++i) d[i] /= l;
+    }
+
+    // Face pixel centre (x,y) of a size by size face, in -1 to 1.
+    float face_coord (uimglen_t i, uimglen_t size)
+    {
+        return (i + 0.5f) * 2 / size - 1;
+    }
+
+    void check_faces (const ImageBase *const *faces)
+    {
+        uimglen_t size = faces[0]->width;
+        for (unsigned f=0 ; f<6 ; ++f) {
+            const ImageBase *img = faces[f];
+            if (img->width != size || img->height != size)
+                EXCEPTEX << "Cube faces must be square and all the same size." << ENDL;
+            if (img->channels() != faces[0]->channels() || img->hasAlpha() != faces[0]->hasAlpha())
+                EXCEPTEX << "Cube faces must all have the same channels." << ENDL;
+        }
+        if (size == 0) EXCEPTEX << "Cube faces must not be empty." << ENDL;
+    }
+
+    // Fill 6 size by size faces in parallel, f(dir, out) writing the n channels of each texel
+    // given its (normalised) direction.
+    template<class F> void fill_faces (ImageBase **out, uimglen_t size, size_t cost_per_texel, F f)
+    {
+        chan_t n = out[0]->channels();
+        parallel_for(6 * size_t(size), size * cost_per_texel, [&] (size_t begin, size_t end) {
+            for (size_t row=begin ; row<end ; ++row) {
+                unsigned face = row / size;
+                uimglen_t y = row % size;
+                float *o = &out[face]->raw()[size_t(y) * size * n];
+                for (uimglen_t x=0 ; x<size ; ++x) {
+                    float d[3];
+                    cube_direction(face, face_coord(x, size), face_coord(y, size), d);
+                    normalise(d);
+                    f(d, &o[size_t(x) * n]);
+                }
+            }
+        });
+    }
+
+    void alloc_faces (const ImageBase *like, uimglen_t size, ImageBase **out)
+    {
+        for (unsigned f=0 ; f<6 ; ++f) out[f] = image_alloc(size, size, like->channels(), like->hasAlpha());
+    }
+
+    // One TextureSampler per face so that lookups can use the face mips.
+    struct CubeSource {
+        std::unique_ptr<TextureSampler> faces[6];
+        chan_t channels;
+
+        CubeSource (const ImageBase *const *src, SampleFilter filter, bool mip_linear)
+          : channels(src[0]->channels())
+        {
+            for (unsigned f=0 ; f<6 ; ++f) {
+                std::vector<ImageBase*> mips(1, const_cast<ImageBase*>(src[f]));
+                faces[f].reset(new TextureSampler(mips, filter, mip_linear, SAMPLE_CLAMP, 1));
+            }
+        }
+
+        void sample (const float *d, float lod, float *out) const
+        {
+            unsigned face;
+            float u, v;
+            cube_lookup(d, face, u, v);
+            faces[face]->sample(u, v, lod, out);
+        }
+    };
+
+    float radical_inverse (uint32_t bits)
+    {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return float(bits) * 2.3283064365386963e-10f;
+    }
+
+    // A GGX importance sample with the view along the normal, so the reflected direction in
+    // tangent space (normal along z), its cosine weight and the mip to read it from are the
+    // same for every texel of the level.
+    struct SpecularSample {
+        float l[3];
+        float weight;
+        float lod;
+    };
+
+    std::vector<SpecularSample> specular_samples (float roughness, unsigned count, uimglen_t size)
+    {
+        float a = roughness * roughness;
+        float a2 = a * a;
+        float texel_solid_angle = 4 * PI / (6.0f * size * size);
+        std::vector<SpecularSample> r;
+        for (unsigned i=0 ; i<count ; ++i) {
+            float e1 = (i + 0.5f) / count;
+            float e2 = radical_inverse(i);
+            float phi = 2 * PI * e1;
+            float cos_theta = std::sqrt((1 - e2) / (1 + (a2 - 1) * e2));
+            float sin_theta = std::sqrt(std::max(0.0f, 1 - cos_theta * cos_theta));
+            float h[3] = { sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta };
+            SpecularSample s;
+            s.l[0] = 2 * h[2] * h[0];
+            s.l[1] = 2 * h[2] * h[1];
+            s.l[2] = 2 * h[2] * h[2] - 1;
+            if (s.l[2] <= 0) continue;
+            s.weight = s.l[2];
+            float denom = cos_theta * cos_theta * (a2 - 1) + 1;
+            float pdf = a2 / (PI * denom * denom) / 4;
+            float sample_solid_angle = 1 / (count * pdf);
+            s.lod = std::max(0.0f, 0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1);
+            r.push_back(s);
+        }
+        return r;
+    }
+
+    template<chan_t n> void equirect_faces (const ImageBase *src, SampleFilter filter, ImageBase **faces)
+    {
+        const float zero[4] = {0, 0, 0, 0};
+        Sampler2D<n> s(src->raw(), src->width, src->height, SAMPLE_WRAP, SAMPLE_CLAMP, zero);
+        float w = src->width, h = src->height;
+        fill_faces(faces, faces[0]->width, 16, [&] (const float *d, float *out) {
+            float lon = std::atan2(d[0], -d[2]);
+            float lat = std::asin(std::max(-1.0f, std::min(d[1], 1.0f)));
+            s.sample(filter, (lon / float(2 * PI) + 0.5f) * w, (lat / float(PI) + 0.5f) * h, out);
+        });
+    }
+
+    template<chan_t n> void faces_equirect (const ImageBase *const *faces, SampleFilter filter,
+                                            ImageBase *dst)
+    {
+        const float zero[4] = {0, 0, 0, 0};
+        uimglen_t size = faces[0]->width;
+        std::vector<Sampler2D<n> > s;
+        for (unsigned f=0 ; f<6 ; ++f)
+            s.push_back(Sampler2D<n>(faces[f]->raw(), size, size, SAMPLE_CLAMP, SAMPLE_CLAMP, zero));
+        uimglen_t w = dst->width, h = dst->height;
+        float *out = dst->raw();
+        parallel_for(h, size_t(w) * 16, [&] (size_t begin, size_t end) {
+            for (size_t y=begin ; y<end ; ++y) {
+                float lat = ((y + 0.5f) / h - 0.5f) * float(PI);
+                for (uimglen_t x=0 ; x<w ; ++x) {
+                    float lon = ((x + 0.5f) / w - 0.5f) * float(2 * PI);
+                    float d[3] = { std::cos(lat) * std::sin(lon), std::sin(lat), -std::cos(lat) * std::cos(lon) };
+                    unsigned face;
+                    float u, v;
+                    cube_lookup(d, face, u, v);
+                    s[face].sample(filter, u * size, v * size, &out[(y*w + x) * n]);
+                }
+            }
+        });
+    }
+
+}
+
+void cube_direction (unsigned face, float px, float py, float *d)
+{
+    switch (face) {
+        case 0: d[0] = 1; d[1] = -py; d[2] = -px; break;
+        case 1: d[0] = -1; d[1] = -py; d[2] = px; break;
+        case 2: d[0] = -px; d[1] = 1; d[2] = py; break;
+        case 3: d[0] = -px; d[1] = -1; d[2] = -py; break;
+        case 4: d[0] = px; d[1] = -py; d[2] = 1; break;
+        default: d[0] = -px; d[1] = -py; d[2] = -1; break;
+    }
+}
+
+void cube_from_equirect (const ImageBase *src, uimglen_t size, SampleFilter filter, ImageBase **faces)
+{
+    if (src->width == 0 || src->height == 0) EXCEPTEX << "Equirectangular image is empty." << ENDL;
+    if (size == 0) EXCEPTEX << "Cube faces must not be empty." << ENDL;
+    alloc_faces(src, size, faces);
+    switch (src->channels()) {
+        case 1: equirect_faces<1>(src, filter, faces); break;
+        case 2: equirect_faces<2>(src, filter, faces); break;
+        case 3: equirect_faces<3>(src, filter, faces); break;
+        case 4: equirect_faces<4>(src, filter, faces); break;
+    }
+}
+
+ImageBase *cube_to_equirect (const ImageBase *const *faces, uimglen_t width, uimglen_t height,
+                             SampleFilter filter)
+{
+    check_faces(faces);
+    ImageBase *dst = image_alloc(width, height, faces[0]->channels(), faces[0]->hasAlpha());
+    switch (dst->channels()) {
+        case 1: faces_equirect<1>(faces, filter, dst); break;
+        case 2: faces_equirect<2>(faces, filter, dst); break;
+        case 3: faces_equirect<3>(faces, filter, dst); break;
+        case 4: faces_equirect<4>(faces, filter, dst); break;
+    }
+    return dst;
+}
+
+void cube_irradiance (const ImageBase *const *faces, uimglen_t size, ImageBase **out)
+{
+    check_faces(faces);
+    if (size == 0) EXCEPTEX << "Cube faces must not be empty." << ENDL;
+    CubeSource src(faces, SAMPLE_BILINEAR, false);
+    chan_t n = src.channels;
+
+    // Every texel of a small mip of the input, as a direction, solid angle and radiance.
+    unsigned level = 0;
+    uimglen_t in_size = faces[0]->width;
+    while (in_size > 32) {
+        in_size /= 2;
+        level++;
+    }
+    size_t texels = 6 * size_t(in_size) * in_size;
+    std::vector<float> dirs(texels * 3), radiance(texels * n), solid_angle(texels);
+    for (size_t i=0 ; i<texels ; ++i) {
+        unsigned face = i / (size_t(in_size) * in_size);
+        uimglen_t x = i % in_size, y = (i / in_size) % in_size;
+        float px = face_coord(x, in_size), py = face_coord(y, in_size);
+        float *d = &dirs[i * 3];
+        cube_direction(face, px, py, d);
+        normalise(d);
+        float texel = 2.0f / in_size;
+        solid_angle[i] = texel * texel / std::pow(1 + px*px + py*py, 1.5f);
+        src.faces[face]->sample((x + 0.5f) / in_size, (y + 0.5f) / in_size, level, &radiance[i * n]);
+    }
+
+    alloc_faces(faces[0], size, out);
+    fill_faces(out, size, texels, [&] (const float *nrm, float *o) {
+        double acc[4] = {0, 0, 0, 0};
+        double total = 0;
+        for (size_t i=0 ; i<texels ; ++i) {
+            const float *d = &dirs[i * 3];
+            float c = nrm[0]*d[0] + nrm[1]*d[1] + nrm[2]*d[2];
+            if (c <= 0) continue;
+            double w = c * solid_angle[i];
+            for (chan_t ch=0 ; ch<n ; ++ch) acc[ch] += w * radiance[i * n + ch];
+            total += w;
+        }
+        for (chan_t ch=0 ; ch<n ; ++ch) o[ch] = acc[ch] / total;
+    });
+}
+
+void cube_specular (const ImageBase *const *faces, unsigned samples, std::vector<ImageBase*> *out)
+{
+    check_faces(faces);
+    if (samples == 0) EXCEPTEX << "Need at least one sample per texel." << ENDL;
+    CubeSource src(faces, SAMPLE_BILINEAR, true);
+    chan_t n = src.channels;
+    uimglen_t size0 = faces[0]->width;
+    unsigned levels = 1;
+    for (uimglen_t s=size0 ; s>1 ; s/=2) levels++;
+
+    for (unsigned f=0 ; f<6 ; ++f) out[f].push_back(faces[f]->clone(false, false));
+    for (unsigned m=1 ; m<levels ; ++m) {
+        uimglen_t size = std::max<uimglen_t>(1, size0 >> m);
+        std::vector<SpecularSample> lobe = specular_samples(float(m) / (levels - 1), samples, size0);
+        ImageBase *level[6];
+        alloc_faces(faces[0], size, level);
+        fill_faces(level, size, lobe.size() * 8, [&] (const float *nrm, float *o) {
+            // Tangent frame around the normal.
+            float up[3] = {0, 0, 1};
+            if (std::fabs(nrm[2]) > 0.999f) { up[0] = 1; up[2] = 0; }
+            float t[3] = { up[1]*nrm[2] - up[2]*nrm[1], up[2]*nrm[0] - up[0]*nrm[2], up[0]*nrm[1] - up[1]*nrm[0] };
+            normalise(t);
+            float b[3] = { nrm[1]*t[2] - nrm[2]*t[1], nrm[2]*t[0] - nrm[0]*t[2], nrm[0]*t[1] - nrm[1]*t[0] };
+            float acc[4] = {0, 0, 0, 0};
+            float total = 0;
+            for (const SpecularSample &s : lobe) {
+                float d[3];
+                for (int i=0 ; i<3 ; ++i) d[i] = t[i]*s.l[0] + b[i]*s.l[1] + nrm[i]*s.l[2];
+                float r[4];
+                src.sample(d, s.lod, r);
+                for (chan_t c=0 ; c<n ; ++c) acc[c] += s.weight * r[c];
+                total += s.weight;
+            }
+            for (chan_t c=0 ; c<n ; ++c) o[c] = acc[c] / total;
+        });
+        for (unsigned f=0 ; f<6 ; ++f) out[f].push_back(level[f]);
+    }
+}
@@ -0,0 +1,55 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CUBEMAP_H
+#define CUBEMAP_H
+
+#include <vector>
+
+#include "image.h"
+#include "sample.h"
+
+/** Cube faces are always in the order dds_save_cube takes them: +x, -x, +y, -y, +z, -z.  Within
+ * face f, pixel (px,py) with both in -1 to 1 across the face looks in the direction
+ * cube_direction gives, which is the convention of examples/cubemap.lua.  Equirectangular images
+ * have +y up, longitude across (-z in the middle) and latitude up the image. */
+void cube_direction (unsigned face, float px, float py, float *dir);
+
+/** Project an equirectangular panorama onto 6 size by size faces, written to faces. */
+void cube_from_equirect (const ImageBase *src, uimglen_t size, SampleFilter filter,
+                         ImageBase **faces);
+
+/** The inverse of cube_from_equirect.  The faces must be square, the same size and channels. */
+ImageBase *cube_to_equirect (const ImageBase *const *faces, uimglen_t width, uimglen_t height,
+                             SampleFilter filter);
+
+/** Diffuse irradiance: each texel of the size by size output faces is the cosine-weighted mean
+ * of the radiance over its hemisphere.  The integral is a direct sum over a small mip of the
+ * input (at most 32x32 per face, each texel weighted by its solid angle), so there is no noise. */
+void cube_irradiance (const ImageBase *const *faces, uimglen_t size, ImageBase **out);
+
+/** Split-sum specular prefilter: one mip chain per face down to 1x1, mip m filtered with the GGX
+ * lobe of roughness m/(levels-1), so mip 0 is the input itself.  Each texel takes the given
+ * number of importance samples, each read from the mip of the input whose texels match the
+ * sample's solid angle (filtered importance sampling), which keeps the noise down. */
+void cube_specular (const ImageBase *const *faces, unsigned samples, std::vector<ImageBase*> *out);
+
+#endif
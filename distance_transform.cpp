@@ -0,0 +1,214 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <vector>
+
+#include <exception.h>
+
+#include "distance_transform.h"
+#include "parallel.h"
+
+// 1D squared distance transform of the sampled function f (lower envelope of parabolas rooted at
+// each sample).  Samples at EDT_INF are left out of the envelope entirely.  v and z are scratch
+// space of size n and n+1.  Intersections are computed in double since q*q loses precision in
+// float on large images.  If arg is not null, it receives the index of the nearest sample.
+static void edt_1d (const float *f, float *d, unsigned n, unsigned *v, double *z, unsigned *arg)
+{
+    unsigned k = 0;
+    bool any = false;
+    for (unsigned q=0 ; q<n ; ++q) {
+        if (f[q] >= EDT_INF) continue;
+        if (!any) {
+            v[0] = q;
+            z[0] = -EDT_INF;
+            z[1] = EDT_INF;
+            any = true;
+            continue;
+        }
+        double s;
+        while (true) {
+            unsigned p = v[k];
+            s = ((f[q] + double(q)*q) - (f[p] + double(p)*p)) / (2.0*q - 2.0*p);
+            if (s > z[k]) break;
+            // z[0] is -infinity so this never goes below 0.
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = EDT_INF;
+    }
+
+    if (!any) {
+        for (unsigned q=0 ; q<n ; ++q) d[q] = EDT_INF;
+        if (arg != nullptr)
+            for (unsigned q=0 ; q<n ; ++q) arg[q] = 0;
+        return;
+    }
+
+    k = 0;
+    for (unsigned q=0 ; q<n ; ++q) {
+        while (z[k+1] < q) k++;
+        double dq = double(q) - v[k];
+        d[q] = dq*dq + f[v[k]];
+        if (arg != nullptr) arg[q] = v[k];
+    }
+}
+
+void edt_squared (float *grid, uimglen_t width, uimglen_t height, size_t *nearest)
+{
+    // Row of the nearest seed in the same column, after the first pass.
+    std::vector<unsigned> seed_row(nearest == nullptr ? 0 : size_t(width) * height);
+
+    // Columns.
+    parallel_for(width, height, [&] (size_t begin, size_t end) {
+        std::vector<float> f(height), d(height);
+        std::vector<double> z(height+1);
+        std::vector<unsigned> v(height), arg(height);
+        for (size_t x=begin ; x<end ; ++x) {
+            for (uimglen_t y=0 ; y<height ; ++y) f[y] = grid[size_t(y)*width + x];
+            edt_1d(&f[0], &d[0], height, &v[0], &z[0], nearest == nullptr ? nullptr : &arg[0]);
+            for (uimglen_t y=0 ; y<height ; ++y) grid[size_t(y)*width + x] = d[y];
+            if (nearest != nullptr)
+                for (uimglen_t y=0 ; y<height ; ++y) seed_row[size_t(y)*width + x] = arg[y];
+        }
+    });
+
+    // Rows.  The nearest seed is then in the column found here, at the row found above.
+    parallel_for(height, width, [&] (size_t begin, size_t end) {
+        std::vector<float> f(width);
+        std::vector<double> z(width+1);
+        std::vector<unsigned> v(width), arg(width);
+        for (size_t y=begin ; y<end ; ++y) {
+            float *row = &grid[y*width];
+            f.assign(row, row + width);
+            edt_1d(&f[0], row, width, &v[0], &z[0], nearest == nullptr ? nullptr : &arg[0]);
+            if (nearest == nullptr) continue;
+            for (uimglen_t x=0 ; x<width ; ++x) {
+                size_t i = y*width + x;
+                nearest[i] = row[x] >= EDT_INF ? EDT_NONE
+                                               : seed_row[y*width + arg[x]] * size_t(width) + arg[x];
+            }
+        }
+    });
+}
+
+static const float *mask_channel (const ImageBase *mask, chan_t &stride)
+{
+    if (!mask->hasAlpha() && mask->channels() != 1) {
+        EXCEPT << "Distance fields need an image with 1 channel or an alpha channel, got: " << mask << ENDL;
+    }
+    stride = mask->channels();
+    return mask->raw() + (stride - 1);
+}
+
+Image<1,0> *distance_transform (const ImageBase *mask, float threshold)
+{
+    uimglen_t width = mask->width;
+    uimglen_t height = mask->height;
+    size_t pixels = mask->numPixels();
+    chan_t stride;
+    const float *src = mask_channel(mask, stride);
+
+    Image<1,0> *r = new Image<1,0>(width, height);
+    float *dst = r->raw();
+    for (size_t i=0 ; i<pixels ; ++i)
+        dst[i] = src[i*stride] >= threshold ? 0 : EDT_INF;
+    if (pixels > 0) edt_squared(dst, width, height);
+    parallel_for(height, width, [&] (size_t begin, size_t end) {
+        for (size_t i=begin*width ; i<end*width ; ++i)
+            dst[i] = dst[i] >= EDT_INF ? EDT_INF : sqrtf(dst[i]);
+    });
+    return r;
+}
+
+Image<1,0> *sdf_from_mask (const ImageBase *mask, float threshold, float spread)
+{
+    uimglen_t width = mask->width;
+    uimglen_t height = mask->height;
+    size_t pixels = mask->numPixels();
+    chan_t stride;
+    const float *src = mask_channel(mask, stride);
+
+    // Distance from inside pixels to the nearest outside pixel, and vice versa.
+    std::vector<float> to_outside(pixels), to_inside(pixels);
+    for (size_t i=0 ; i<pixels ; ++i) {
+        bool inside = src[i*stride] >= threshold;
+        to_outside[i] = inside ? EDT_INF : 0;
+        to_inside[i] = inside ? 0 : EDT_INF;
+    }
+    if (pixels > 0) {
+        edt_squared(&to_outside[0], width, height);
+        edt_squared(&to_inside[0], width, height);
+    }
+
+    // The edge lies between pixel centres, so half a pixel closer than the nearest pixel on the
+    // other side.
+    Image<1,0> *r = new Image<1,0>(width, height);
+    float *dst = r->raw();
+    parallel_for(height, width, [&] (size_t begin, size_t end) {
+        for (size_t i=begin*width ; i<end*width ; ++i) {
+            float d;
+            if (to_inside[i] == 0) {
+                d = to_outside[i] >= EDT_INF ? EDT_INF : sqrtf(to_outside[i]) - 0.5f;
+            } else {
+                d = to_inside[i] >= EDT_INF ? -EDT_INF : 0.5f - sqrtf(to_inside[i]);
+            }
+            dst[i] = sdf_normalise(d, spread);
+        }
+    });
+    return r;
+}
+
+ImageBase *alpha_bleed (const ImageBase *src, float max_distance)
+{
+    if (!src->hasAlpha()) {
+        EXCEPT << "Bleeding needs an image with an alpha channel, got: " << src << ENDL;
+    }
+    uimglen_t width = src->width;
+    uimglen_t height = src->height;
+    size_t pixels = src->numPixels();
+    chan_t stride = src->channels();
+    chan_t colour_channels = src->colourChannels();
+    const float *in = src->raw();
+
+    ImageBase *r = src->clone(false, false);
+    if (pixels == 0) return r;
+    float *out = r->raw();
+
+    std::vector<float> grid(pixels);
+    std::vector<size_t> nearest(pixels);
+    for (size_t i=0 ; i<pixels ; ++i)
+        grid[i] = in[i*stride + colour_channels] > 0 ? 0 : EDT_INF;
+    edt_squared(&grid[0], width, height, &nearest[0]);
+
+    float max_squared = max_distance * max_distance;
+    parallel_for(height, width, [&] (size_t begin, size_t end) {
+        for (size_t i=begin*width ; i<end*width ; ++i) {
+            if (grid[i] == 0 || nearest[i] == EDT_NONE || grid[i] > max_squared) continue;
+            for (chan_t c=0 ; c<colour_channels ; ++c)
+                out[i*stride + c] = in[nearest[i]*stride + c];
+        }
+    });
+    return r;
+}
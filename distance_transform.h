@@ -0,0 +1,69 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef DISTANCE_TRANSFORM_H
+#define DISTANCE_TRANSFORM_H
+
+#include "image.h"
+
+/** Used in distance transform grids for pixels that are not seeds. */
+static const float EDT_INF = 1E20f;
+
+/** Marks pixels with no nearest seed in edt_squared. */
+static const size_t EDT_NONE = size_t(-1);
+
+/** Exact squared Euclidean distance transform, in place (Felzenszwalb &
+ * Huttenlocher / Meijster).  On input, grid holds 0 at seed pixels and EDT_INF
+ * elsewhere (other values act as a per-pixel squared distance offset).  On
+ * output each pixel holds the squared distance in pixels to the nearest seed.
+ * If nearest is not null, it receives the index (y*width + x) of that seed, or
+ * EDT_NONE if there are no seeds.  Linear time, parallel over columns then
+ * rows. */
+void edt_squared (float *grid, uimglen_t width, uimglen_t height, size_t *nearest = nullptr);
+
+/** Euclidean distance in pixels from each pixel to the nearest pixel of the mask
+ * whose value is at least threshold (0 for those pixels themselves).  The mask
+ * channel is chosen as for sdf_from_mask.  If no pixel reaches the threshold,
+ * every pixel gets EDT_INF. */
+Image<1,0> *distance_transform (const ImageBase *mask, float threshold);
+
+/** Signed distance field of a mask: the distance in pixels to the edge of the
+ * shape, positive inside and negative outside.  A pixel is inside if its value
+ * is at least threshold.  The mask's alpha channel is used if it has one,
+ * otherwise it must have a single channel.  If spread is not 0, the distance is
+ * mapped to 0.5 + d/(2*spread) and clamped to [0,1]. */
+Image<1,0> *sdf_from_mask (const ImageBase *mask, float threshold, float spread);
+
+/** Copy the colour of each pixel whose alpha is 0 from the nearest pixel whose
+ * alpha is not, within max_distance pixels.  Alpha is left unchanged.  This
+ * stops transparent texels from darkening their neighbours' edges when the
+ * texture is filtered, mipmapped or block compressed. */
+ImageBase *alpha_bleed (const ImageBase *src, float max_distance);
+
+/** Map a signed distance to [0,1] as described for sdf_from_mask. */
+static inline float sdf_normalise (float d, float spread)
+{
+    if (spread == 0) return d;
+    float v = 0.5f + d / (2 * spread);
+    return v < 0 ? 0 : v > 1 ? 1 : v;
+}
+
+#endif
@@ -398,6 +398,155 @@ filtered with a BOX filter.]],
     { "return", "array of arrays of Images" },
 }
 
+doc { "function", "normal_mipmaps", module="Image Globals",
+
+[[Like mipmaps() but for a normal map encoded as by heightToNormal (2 or 3
+channels).  Each 2x2 block is averaged as vectors and then renormalised, so the
+normals in the smaller mipmaps stay unit length.]],
+
+    { "param", "img", "Image" },
+    { "return", "array of Images" },
+}
+
+doc { "function", "load_lut", module="Image Globals",
+
+[[Read a colour grading LUT in the .cube format, with a 3D table, a 1D shaper,
+or a shaper followed by a table.  Apply it to images with applyLut.]],
+
+    { "param", "filename", "string" },
+    { "return", "ColourLut" },
+}
+
+doc { "function", "sampler", module="Image Globals",
+
+[[Create a TextureSampler from an image, whose mipmaps are then built with a
+box filter, or from an array of mipmaps such as mipmaps() returns.  The
+optional table can set the filter (NEAREST, BILINEAR, CATMULLROM, or the
+default TRILINEAR, which also blends between mipmaps), the wrap mode (CLAMP,
+the default WRAP, MIRROR, or COLOUR which reads 0 beyond the edges), and
+aniso, the most samples (1 to 16, default 1) to take along an elongated
+footprint.]],
+
+    { "param", "img", {"Image", "array of Images"} },
+    { "param", "options", "table", optional=true },
+    { "return", "TextureSampler" },
+}
+
+doc { "function", "equirect_to_cube", module="Image Globals",
+
+[[Project an equirectangular panorama (longitude across, latitude up, +y up and
+-z in the middle) onto the 6 faces of a cube of the given size, returned in the
+order dds_save_cube takes them: +x, -x, +y, -y, +z, -z.  The filter is NEAREST,
+the default BILINEAR, or CATMULLROM.]],
+
+    { "param", "img", "Image" },
+    { "param", "face_size", "number" },
+    { "param", "filter", "string", optional=true },
+    { "return", "Image" },
+    { "return", "Image" },
+    { "return", "Image" },
+    { "return", "Image" },
+    { "return", "Image" },
+    { "return", "Image" },
+}
+
+doc { "function", "cube_to_equirect", module="Image Globals",
+
+[[The inverse of equirect_to_cube: render the 6 faces of a cube (square, all the
+same size) as an equirectangular panorama of the given size.]],
+
+    { "param", "pos_x", "Image" },
+    { "param", "neg_x", "Image" },
+    { "param", "pos_y", "Image" },
+    { "param", "neg_y", "Image" },
+    { "param", "pos_z", "Image" },
+    { "param", "neg_z", "Image" },
+    { "param", "size", "vector2" },
+    { "param", "filter", "string", optional=true },
+    { "return", "Image" },
+}
+
+doc { "function", "cube_irradiance", module="Image Globals",
+
+[[Diffuse lighting from a cube map: each texel of the 6 returned faces (of the
+given size) is the cosine-weighted mean of the input over the hemisphere around
+its direction.  The integral is an exact sum over a 32x32 (or smaller) mipmap of
+the input, so there is no noise.]],
+
+    { "param", "pos_x", "Image" },
+    { "param", "neg_x", "Image" },
+    { "param", "pos_y", "Image" },
+    { "param", "neg_y", "Image" },
+    { "param", "pos_z", "Image" },
+    { "param", "neg_z", "Image" },
+    { "param", "face_size", "number" },
+    { "return", "Image" },
+    { "return", "Image" },
+    { "return", "Image" },
+    { "return", "Image" },
+    { "return", "Image" },
+    { "return", "Image" },
+}
+
+doc { "function", "cube_specular", module="Image Globals",
+
+[[Prefilter a cube map for specular lighting.  Returns 6 arrays of mipmaps, one
+per face, which can be passed straight to dds_save_cube.  Mipmap m is the input
+filtered with the GGX lobe of roughness m/(levels-1), so the first is the input
+itself and the 1x1 one is fully rough.  Each texel takes the given number of
+importance samples (default 64), each read from the mipmap of the input that
+matches its footprint, which keeps the noise down.]],
+
+    { "param", "pos_x", "Image" },
+    { "param", "neg_x", "Image" },
+    { "param", "pos_y", "Image" },
+    { "param", "neg_y", "Image" },
+    { "param", "pos_z", "Image" },
+    { "param", "neg_z", "Image" },
+    { "param", "samples", "number", optional=true },
+    { "return", "array of Images" },
+    { "return", "array of Images" },
+    { "return", "array of Images" },
+    { "return", "array of Images" },
+    { "return", "array of Images" },
+    { "return", "array of Images" },
+}
+
+doc { "function", "psnr", module="Image Globals",
+
+[[Peak signal to noise ratio between two images of the same size and channels,
+in dB, over all channels.  The peak defaults to 1, the maximum of the usual
+value range.  Identical images give infinity.]],
+
+    { "param", "a", "Image" },
+    { "param", "b", "Image" },
+    { "param", "peak", "number", optional=true },
+    { "return", "number" },
+}
+
+doc { "function", "ssim", module="Image Globals",
+
+[[Structural similarity between two images of the same size and channels, using
+the standard 11x11 Gaussian window (sigma 1.5), averaged over the image and then
+over channels.  1 means identical.  This tracks perceived quality much more
+closely than meanDiff or rmsDiff.  The images must be at least 11x11.]],
+
+    { "param", "a", "Image" },
+    { "param", "b", "Image" },
+    { "return", "number" },
+}
+
+doc { "function", "ms_ssim", module="Image Globals",
+
+[[Multi-scale structural similarity: SSIM's contrast and structure terms are
+combined over 5 successively halved resolutions, which makes it less sensitive
+to the viewing distance.  Images too small for 5 scales use as many as fit.]],
+
+    { "param", "a", "Image" },
+    { "param", "b", "Image" },
+    { "return", "number" },
+}
+
 -- }}}
 
 -- {{{ Text
@@ -417,6 +566,24 @@ purpose.  Kerning information is not provided.]],
     { "return", "Image" },
 }
 
+doc { "function", "text_codepoint_sdf", module="Text",
+
+[[Similar to text_codepoint() but returns a signed distance field of the
+character instead of its coverage.  The distance is computed from the glyph's
+outline at the requested size, so there is no need to render a huge glyph and
+scale it down.  The image is larger than that of text_codepoint() by the spread
+(rounded up) on each side, so that the field is not cut off.  The field is
+mapped so that the edge of the glyph is 0.5, spread pixels inside is 1, and
+spread pixels outside is 0 (see Image.sdf).  Bitmap fonts have no outline, so
+their rendered glyph is used instead.]],
+
+    { "param", "font", "string" },
+    { "param", "size", "vector2" },
+    { "param", "char", "string" },
+    { "param", "spread", "number" },
+    { "return", "Image" },
+}
+
 doc { "function", "text", module="Text",
 
 [[Create a new image containing the rendered line of text.  The image is
@@ -437,11 +604,119 @@ shadows, colour, etc.]],
     { "return", "Image" },
 }
 
+doc { "function", "text_batch", module="Text",
+
+[[Render many strings with the same font and size, packed into a single image
+(an atlas), as if text() had been called for each one.  This is much faster than
+calling text() and drawImage() repeatedly.  The font is loaded once, and glyphs
+common to several strings are only rendered once.  The options table may
+contain: width (of the atlas, otherwise chosen automatically), padding (empty
+pixels around each string, default 1), and power_of_two (round the atlas
+dimensions up to powers of 2, default false).  The second return value is a
+table with an entry for each string, in the same order.  Each entry has pos (the
+bottom left corner of the string's rectangle in the atlas), size (the same as
+the size of the image text() would return), and origin (where the baseline of
+the string starts in the atlas).]],
+
+    { "param", "font", "string" },
+    { "param", "size", "vector2" },
+    { "param", "strings", "array of strings" },
+    { "param", "options", "table", optional=true },
+    { "return", "Image" },
+    { "return", "array of tables" },
+}
+
 -- }}}
 
 
 -- {{{ Image Class
 
+doc {
+    "class",
+    "IntegralImage",
+
+[[A summed-area table of an image, created with its integral() method.  Each
+entry holds the sum of all pixels below and to the left of it, in double
+precision, so the sum or mean of any rectangular region can be found with 4
+lookups regardless of its size.  This makes it cheap to score thousands of
+regions of an image.]],
+
+    { "field", "width", "number", "The width of the original image.", },
+    { "field", "height", "number", "The height of the original image.", },
+    { "field", "size", "vector2", "The width and height as a single value.", },
+    { "field", "channels", "number", "The number of channels (including alpha).", },
+    {
+        "method",
+        "sum",
+        "The sum of each channel over the region of the given size whose bottom left corner is at the given position.  The region is clipped to the image.",
+        { "param", "pos", "vector2" },
+        { "param", "size", "vector2" },
+        { "return", "colour" },
+    },
+    {
+        "method",
+        "mean",
+        "The mean of each channel over the region, clipped to the image.  If the region does not overlap the image at all, the result is 0.",
+        { "param", "pos", "vector2" },
+        { "param", "size", "vector2" },
+        { "return", "colour" },
+    },
+}
+
+doc {
+    "class",
+    "TextureSampler",
+
+[[Filtered lookups into a texture and its mipmaps, created with sampler().
+Texture coordinates run from 0 to 1 across the image, and lookups outside that
+range are resolved by the wrap mode.  The mipmaps are copied when the sampler
+is created, so it can be used any number of times without rebuilding them.]],
+
+    { "field", "width", "number", "The width of the largest mipmap.", },
+    { "field", "height", "number", "The height of the largest mipmap.", },
+    { "field", "size", "vector2", "The width and height as a single value.", },
+    { "field", "channels", "number", "The number of channels (including alpha).", },
+    { "field", "hasAlpha", "boolean", "Whether the texture has an alpha channel.", },
+    { "field", "levels", "number", "The number of mipmaps.", },
+    {
+        "method",
+        "sample",
+        "Sample the texture at the given coordinates and level of detail (default 0, the largest mipmap).",
+        { "param", "uv", "vector2" },
+        { "param", "lod", "number", optional=true },
+        { "return", "colour" },
+    },
+    {
+        "method",
+        "sampleGrad",
+        "Sample the texture at the given coordinates, with the level of detail chosen from the rate of change of the coordinates along x and y of whatever is being drawn, as a GPU does.  Elongated footprints take up to aniso samples along their long axis.",
+        { "param", "uv", "vector2" },
+        { "param", "dx", "vector2" },
+        { "param", "dy", "vector2" },
+        { "return", "colour" },
+    },
+    {
+        "method",
+        "sampleImage",
+        "Sample the texture at the coordinates held in each pixel of a 2 channel image, giving an image of the same size.  The rates of change are taken from neighbouring pixels, so a coordinate image that shrinks the texture reads from the smaller mipmaps.",
+        { "param", "uvs", "Image" },
+        { "return", "Image" },
+    },
+}
+
+doc {
+    "class",
+    "ColourLut",
+
+[[A colour grading lookup table loaded by load_lut(), for use with
+Image:applyLut().  The table is held natively, so loading it once and applying
+it to many images only parses the file once.]],
+
+    { "field", "size", "number", "The number of entries along each side of the 3D table (0 if there is none).", },
+    { "field", "shaperSize", "number", "The number of entries in the 1D shaper (0 if there is none).", },
+    { "field", "title", "string", "The TITLE given in the file (may be empty).", },
+}
+
 doc {
     "class",
     "Image",
@@ -535,7 +810,7 @@ create a channel containing 1 or 0, respectively.]],
     {
         "method",
         "rotate",
-        "Create a new image the same as this one but rotated by the given angle (degrees).  The resulting image will have larger area if the angle is not a multiple of 90.",
+        "Create a new image the same as this one but rotated by the given angle (degrees).  The resulting image will have larger area if the angle is not a multiple of 90.  Multiples of 90 move pixels exactly, other angles use bilinear filtering.",
         { "param", "angle", "number" },
         { "return", "Image" },
     },
@@ -672,6 +947,191 @@ create a channel containing 1 or 0, respectively.]],
         { "param", "wrap_x", "boolean", optional=true },
         { "param", "wrap_y", "boolean", optional=true },
     },
+    {
+        "method",
+        "sdf",
+        "Compute a signed distance field from this image, treated as a mask.  Pixels whose value is at least the threshold (default 0.5) are inside the shape.  The image must have a single channel, or an alpha channel which is used as the mask.  The distance to the edge of the shape (in pixels, positive inside) is computed exactly using a linear time Euclidean distance transform, and is then mapped so that the edge is 0.5, spread pixels inside is 1, and spread pixels outside is 0.  A spread of 0 returns the distances in pixels instead.  Such fields can be downscaled much further than the original mask while still giving crisp edges when thresholded at 0.5 in a shader.",
+        { "param", "spread", "number" },
+        { "param", "threshold", "number", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "distanceTransform",
+        "Compute the Euclidean distance (in pixels) from each pixel to the nearest pixel whose value is at least the threshold (default 0.5).  Such pixels get 0.  The image must have a single channel, or an alpha channel which is used instead.  Runs in linear time regardless of the distances involved.",
+        { "param", "threshold", "number", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "erode",
+        "Replace each channel of each pixel with the minimum of that channel within a rectangle of the given radius (a number, or a vector2 giving the radius in each axis), i.e. a (2r+1) by (2r+1) box.  Pixels beyond the edge of the image are ignored.  The cost does not depend on the radius.",
+        { "param", "radius", "number | vector2" },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "dilate",
+        "As erode, but takes the maximum.",
+        { "param", "radius", "number | vector2" },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "open",
+        "Erode, then dilate by the same radius.  Removes bright features smaller than the box.",
+        { "param", "radius", "number | vector2" },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "close",
+        "Dilate, then erode by the same radius.  Fills dark gaps smaller than the box.",
+        { "param", "radius", "number | vector2" },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "bleed",
+        "Push colour out from the visible parts of a texture into the fully transparent parts, so that filtering, mipmapping, and block compression do not darken the edges.  Each pixel with an alpha of 0 takes the colour of the nearest pixel whose alpha is not 0, as long as that pixel is within the given distance (default unlimited).  The alpha channel is not changed.  The image must have an alpha channel.  Uses a linear time distance transform, so this is fast even for large transparent regions.",
+        { "param", "max_distance", "number", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "boxBlur",
+        "Replace each pixel with the mean of the box of pixels around it, of size (2r+1) by (2r+1).  The radius can be a vector2 for a different radius in each axis.  Pixels beyond the edge of the image are treated as in convolve.  Uses running sums, so the cost does not depend on the radius.",
+        { "param", "radius", "number | vector2" },
+        { "param", "wrap_x", "boolean", optional=true },
+        { "param", "wrap_y", "boolean", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "fastGaussian",
+        "Approximate a Gaussian blur with the given standard deviation (in pixels, or a vector2 for each axis) by three box blurs whose sizes are chosen to match its variance.  Unlike convolveSep with a gaussian kernel, the cost does not depend on sigma.  Edges are treated as in convolve.",
+        { "param", "sigma", "number | vector2" },
+        { "param", "wrap_x", "boolean", optional=true },
+        { "param", "wrap_y", "boolean", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "integral",
+        "Build a summed-area table of the image (in double precision), so that the sum or mean of any rectangular region can then be found in constant time.",
+        { "return", "IntegralImage" },
+    },
+    {
+        "method",
+        "histogram",
+        "Count the values of each channel into the given number of equal-width bins covering the range (default 0 to 1).  Values outside the range are counted in the first or last bin.  Returns an array with one element per channel (including alpha), each an array of counts.",
+        { "param", "bins", "number" },
+        { "param", "range", "vector2", optional=true },
+        { "return", "table" },
+    },
+    {
+        "method",
+        "percentile",
+        "The given percentile (0 to 100) of each channel, interpolating between the nearest two values.  E.g. 50 gives the median.",
+        { "param", "p", "number" },
+        { "return", "colour" },
+    },
+    {
+        "method",
+        "equalise",
+        "Histogram equalisation: map each colour channel through its cumulative distribution, so the values are spread evenly between 0 and 1.  The alpha channel is not changed.",
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "autoLevels",
+        "Stretch each colour channel so that the low percentile (default 0.5) maps to 0 and the high percentile (default 99.5) maps to 1, clamping values outside that range.  The alpha channel is not changed.",
+        { "param", "low", "number", optional=true },
+        { "param", "high", "number", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "median",
+        "Median filter: replace each channel of each pixel with the median of that channel over the (2r+1) by (2r+1) box around it (the radius can be a vector2 for a different radius in each axis).  Beyond the edges, the edge pixels are repeated.  For images whose values are all 8 bit levels (e.g. loaded from a PNG), the cost does not depend on the radius.  Otherwise it is exact but slower for large radii.",
+        { "param", "radius", "number | vector2" },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "rank",
+        "As median, but take the given percentile (0 to 100) of each box instead of the 50th.  0 and 100 are the same as erode and dilate.",
+        { "param", "radius", "number | vector2" },
+        { "param", "percentile", "number" },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "warp",
+        "Create a new image of the given size by transforming this one with a 3x3 matrix, given as a table of 9 numbers in row-major order (or 6, for an affine transform).  The matrix maps homogeneous pixel coordinates in this image to those in the new one, so it can express any shear, affine transform or perspective projection.  As usual for such matrices, scaling all of it (even by a negative number) makes no difference.  The filter is NEAREST, BILINEAR, or CATMULLROM.  The border mode (CLAMP, WRAP, MIRROR, or COLOUR) says what is read beyond the edges of this image; COLOUR uses the given colour, which defaults to 0 and also fills any part of the output beyond the horizon of a perspective transform.",
+        { "param", "matrix", "table" },
+        { "param", "size", "vector2" },
+        { "param", "filter", "string" },
+        { "param", "border", "string" },
+        { "param", "colour", "colour", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "remap",
+        "Create a new image the size of the given 2 channel coordinate image, where each pixel is sampled from this image at the position held in the corresponding pixel of the coordinate image.  Positions are in the same units as pixel indexes, so whole numbers read pixels exactly and a coordinate image holding each pixel's own position reproduces this image.  The filter is NEAREST, BILINEAR, or CATMULLROM.  Beyond the edges the image wraps around or the edge pixels are repeated, as for convolve.",
+        { "param", "coords", "Image" },
+        { "param", "filter", "string" },
+        { "param", "wrap_x", "boolean", optional=true },
+        { "param", "wrap_y", "boolean", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "heightToNormal",
+        "Create a tangent-space normal map from the height field in the first channel of this image.  The slope is found with a 3x3 kernel, CENTRAL differences or the default SOBEL or SCHARR (which also smooth across the slope), and scaled by the strength.  The normal (-dh/dx, -dh/dy, 1) is normalised and stored as 0.5 + 0.5*n, in 3 channels, or in 2 (just x and y, ready for BC5) if xy_only is true.  Beyond the edges the height wraps around or the edge pixels are repeated, as for convolve.",
+        { "param", "strength", "number" },
+        { "param", "filter", "string", optional=true },
+        { "param", "wrap_x", "boolean", optional=true },
+        { "param", "wrap_y", "boolean", optional=true },
+        { "param", "xy_only", "boolean", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "stencil",
+        "Run the given number of steps of a stencil computation over the neighbourhood of the given radius (a number, or a vector2 for different radii in x and y).  The kernel is MEAN, MIN or MAX of each channel; EXPAND, which fills pixels with alpha 0 from their opaque neighbours so opaque regions grow by the radius each step; a life-like cellular automaton rule on the first channel, such as \"B3/S23\" for the game of life (with comma-separated counts or ranges like \"B34-45/S33-57\" for larger neighbourhoods); or a single channel image of (2*radius+1) weights for a linear stencil.  Beyond the edges the image wraps around or the edge pixels are repeated, as for convolve.  All the steps run natively, so thousands of them are practical.",
+        { "param", "radius", {"number", "vector2"} },
+        { "param", "kernel", {"string", "Image"} },
+        { "param", "iterations", "number" },
+        { "param", "wrap_x", "boolean", optional=true },
+        { "param", "wrap_y", "boolean", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "applyLut",
+        "Grade the image with a ColourLut from load_lut.  The image must have 3 colour channels; any alpha channel is kept as it is.  The LUT's 1D shaper (if it has one) is applied to each channel, then its 3D table is interpolated with TETRAHEDRAL (the default), which blends 4 corners of each cell and keeps greys on the table's grey axis, or TRILINEAR, which blends all 8.  Colours outside the table's domain are clamped to it.  The image is processed natively in parallel.",
+        { "param", "lut", "ColourLut" },
+        { "param", "interpolation", "string", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "colourMap",
+        "Colour a single channel image through a gradient, which is either an image (its bottom row, from the centre of the first pixel to the centre of the last) or a table of stops.  Each stop is a colour, the stops then being evenly spaced, or a table {position, colour} with positions from 0 to 1 in increasing order.  The range (default vec(0,1)) gives the values that map to the start and end of the gradient, values beyond being clamped.  The result has the gradient's channels, and an alpha channel of the image is multiplied into the gradient's alpha (or added, if the gradient has fewer than 4 channels and no alpha).  The gradient is baked into a table of 4096 steps and the image mapped through it natively in parallel, which is much faster than map with a Lua function.",
+        { "param", "gradient", {"Image", "table"} },
+        { "param", "range", "vector2", optional=true },
+        { "return", "Image" },
+    },
+    {
+        "method",
+        "curve",
+        "Pass each colour channel through a curve, like the curves tool of an image editor.  The points are a table of vector2 (input, output) in increasing order of input, at least 2 of them.  The curve between them is LINEAR, CUBIC (a natural cubic spline), or MONOTONE (the default, a cubic that never overshoots the points).  Inputs beyond the first and last points give their outputs.  The alpha channel is left alone.  The curve is baked into a table of 4096 steps and the image mapped through it natively in parallel.",
+        { "param", "points", "table" },
+        { "param", "interp", "string", optional=true },
+        { "return", "Image" },
+    },
 }
 
 -- }}}
@@ -41,6 +41,11 @@ function visualise_blue2 ()
     mb:map(3, function(m) m=m/(20+m); return vec(m^10,m^2.5,m) end):save("mandelbrot_blue2.png")
 end
 
+function visualise_gradient ()
+    local stops = { vec(0, 0, 0.1), vec(0.1, 0.3, 0.8), vec(1, 1, 1), vec(1, 0.8, 0.2) }
+    mb:colourMap(stops, vec(0, 60)):save("mandelbrot_gradient.png")
+end
+
 print("Run this in the interpreter (luaimg -i -f mandelbrot.lua), then use:")
 print("    mb_generate(sz, iters) --params are optional, defaults to vec(8192, 3072), 500")
 print("    mb_load()")
@@ -48,4 +53,5 @@ print("    mb_save()")
 print("    visualise_simple()")
 print("    visualise_blue1()")
 print("    visualise_blue2()")
+print("    visualise_gradient()")
 
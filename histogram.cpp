@@ -0,0 +1,181 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+#include <exception.h>
+
+#include "histogram.h"
+#include "parallel.h"
+
+// Enough bins that equalisation is smooth for 16 bit sources.
+static const unsigned EQUALISE_BINS = 65536;
+
+// Per-channel ranges, so equalisation can bin every channel over its own extent in one pass.
+static std::vector<uint64_t> count_bins (const ImageBase *src, unsigned bins,
+                                         const std::vector<float> &lo, const std::vector<float> &hi)
+{
+    chan_t channels = src->channels();
+    const float *in = src->raw();
+    uimglen_t width = src->width;
+    std::vector<float> scale(channels);
+    for (chan_t c=0 ; c<channels ; ++c) scale[c] = hi[c] > lo[c] ? bins / (hi[c] - lo[c]) : 0;
+    float last = float(bins - 1);
+
+    std::vector<uint64_t> counts(size_t(bins) * channels, 0);
+    std::mutex merge_lock;
+    parallel_for(src->height, size_t(width) * channels, [&] (size_t begin, size_t end) {
+        std::vector<uint64_t> local(counts.size(), 0);
+        // Compute bin indexes for a row of samples at a time, which the compiler can vectorise,
+        // then scatter them into the counts.
+        std::vector<uint32_t> index(size_t(width) * channels);
+        for (size_t y=begin ; y<end ; ++y) {
+            const float *row = &in[y * width * channels];
+            for (size_t x=0 ; x<width ; ++x) {
+                for (chan_t c=0 ; c<channels ; ++c) {
+                    float b = (row[x * channels + c] - lo[c]) * scale[c];
+                    // Written so that NaN lands in the first bin.
+                    b = !(b > 0) ? 0 : b > last ? last : b;
+                    index[x * channels + c] = uint32_t(b);
+                }
+            }
+            for (size_t x=0 ; x<width ; ++x) {
+                for (chan_t c=0 ; c<channels ; ++c)
+                    local[c * bins + index[x * channels + c]]++;
+            }
+        }
+        std::lock_guard<std::mutex> guard(merge_lock);
+        for (size_t i=0 ; i<counts.size() ; ++i) counts[i] += local[i];
+    });
+    return counts;
+}
+
+std::vector<uint64_t> histogram_count (const ImageBase *src, unsigned bins, float lo, float hi)
+{
+    if (bins == 0) EXCEPT << "Histogram must have at least 1 bin." << ENDL;
+    if (!(hi > lo)) EXCEPT << "Histogram range is empty: [" << lo << ", " << hi << "]" << ENDL;
+    std::vector<float> los(src->channels(), lo), his(src->channels(), hi);
+    return count_bins(src, bins, los, his);
+}
+
+// The p'th percentile of the n values of channel c, found by selection rather than sorting.
+static float channel_percentile (const ImageBase *src, chan_t c, float p)
+{
+    size_t n = src->numPixels();
+    if (n == 0) return 0;
+    chan_t channels = src->channels();
+    const float *in = src->raw();
+    std::vector<float> values(n);
+    for (size_t i=0 ; i<n ; ++i) values[i] = in[i * channels + c];
+
+    double rank = std::min(std::max(p, 0.0f), 100.0f) / 100.0 * (n - 1);
+    size_t below = size_t(std::floor(rank));
+    double frac = rank - below;
+    std::nth_element(values.begin(), values.begin() + below, values.end());
+    float a = values[below];
+    if (frac == 0) return a;
+    // The next value up is the smallest of those after it.
+    float b = *std::min_element(values.begin() + below + 1, values.end());
+    return float(a + (b - a) * frac);
+}
+
+void histogram_percentile (const ImageBase *src, float p, float *out)
+{
+    for (chan_t c=0 ; c<src->channels() ; ++c) out[c] = channel_percentile(src, c, p);
+}
+
+ImageBase *histogram_equalise (const ImageBase *src)
+{
+    chan_t channels = src->channels();
+    chan_t colour_channels = src->colourChannels();
+    size_t n = src->numPixels();
+    ImageBase *r = src->clone(false, false);
+    if (n == 0) return r;
+    float *out = r->raw();
+
+    std::vector<float> lo(channels), hi(channels);
+    // Ignore NaN and infinities, so one bad sample cannot stop the whole channel being equalised.
+    for (chan_t c=0 ; c<channels ; ++c) {
+        lo[c] = std::numeric_limits<float>::infinity();
+        hi[c] = -std::numeric_limits<float>::infinity();
+        for (size_t i=0 ; i<n ; ++i) {
+            float v = out[i * channels + c];
+            if (!std::isfinite(v)) continue;
+            lo[c] = std::min(lo[c], v);
+            hi[c] = std::max(hi[c], v);
+        }
+    }
+
+    std::vector<uint64_t> counts = count_bins(src, EQUALISE_BINS, lo, hi);
+    std::vector<float> cdf(counts.size());
+    for (chan_t c=0 ; c<colour_channels ; ++c) {
+        uint64_t total = 0;
+        for (size_t b=c*EQUALISE_BINS ; b<(c+1)*EQUALISE_BINS ; ++b) {
+            total += counts[b];
+            cdf[b] = float(double(total) / n);
+        }
+    }
+
+    float last = float(EQUALISE_BINS - 1);
+    parallel_for(r->height, size_t(r->width) * channels, [&] (size_t begin, size_t end) {
+        for (size_t i=begin*r->width ; i<end*r->width ; ++i) {
+            for (chan_t c=0 ; c<colour_channels ; ++c) {
+                // A flat channel has nothing to spread out, leave it alone.
+                if (!(hi[c] > lo[c])) continue;
+                float &v = out[i * channels + c];
+                float b = (v - lo[c]) * (EQUALISE_BINS / (hi[c] - lo[c]));
+                b = !(b > 0) ? 0 : b > last ? last : b;
+                v = cdf[c * EQUALISE_BINS + unsigned(b)];
+            }
+        }
+    });
+    return r;
+}
+
+ImageBase *histogram_auto_levels (const ImageBase *src, float low, float high)
+{
+    chan_t channels = src->channels();
+    chan_t colour_channels = src->colourChannels();
+    std::vector<float> lo(colour_channels), hi(colour_channels);
+    for (chan_t c=0 ; c<colour_channels ; ++c) {
+        lo[c] = channel_percentile(src, c, low);
+        hi[c] = channel_percentile(src, c, high);
+    }
+
+    ImageBase *r = src->clone(false, false);
+    float *out = r->raw();
+    parallel_for(r->height, size_t(r->width) * channels, [&] (size_t begin, size_t end) {
+        for (size_t i=begin*r->width ; i<end*r->width ; ++i) {
+            for (chan_t c=0 ; c<colour_channels ; ++c) {
+                float &v = out[i * channels + c];
+                // A flat channel has nothing to stretch, leave it alone.
+                if (!(hi[c] > lo[c])) continue;
+                v = (v - lo[c]) / (hi[c] - lo[c]);
+                v = v < 0 ? 0 : v > 1 ? 1 : v;
+            }
+        }
+    });
+    return r;
+}
@@ -0,0 +1,51 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstdint>
+
+#include <vector>
+
+#include "image.h"
+
+/** Count the values of each channel (including alpha) into bins equal-width
+ * bins covering [lo, hi].  Values outside the range are counted in the first or
+ * last bin.  The result has bins entries for channel 0, then channel 1, etc.
+ * Each thread fills a private histogram and these are summed at the end. */
+std::vector<uint64_t> histogram_count (const ImageBase *src, unsigned bins, float lo, float hi);
+
+/** The p'th percentile (0 to 100) of each channel, interpolating linearly
+ * between the two nearest values.  Writes one value per channel to out. */
+void histogram_percentile (const ImageBase *src, float p, float *out);
+
+/** Histogram equalisation: each colour channel is mapped through its own
+ * cumulative distribution so that the values are spread evenly over [0,1].
+ * Alpha is not changed. */
+ImageBase *histogram_equalise (const ImageBase *src);
+
+/** Stretch each colour channel linearly so that its low'th percentile becomes
+ * 0 and its high'th percentile becomes 1, clamping values outside.  Alpha is
+ * not changed. */
+ImageBase *histogram_auto_levels (const ImageBase *src, float low, float high);
+
+#endif
@@ -39,6 +39,31 @@ extern "C" {
 
 #include "image.h"
 #include "sfi.h"
+#include "startup_profile.h"
+
+static bool freeimage_initialised = false;
+
+static void my_freeimage_error (FREE_IMAGE_FORMAT fif, const char *str)
+{
+    (void) fif;
+    std::cerr << str << std::endl;
+}
+
+void image_init (void)
+{
+    if (freeimage_initialised) return;
+    StartupPhase phase("FreeImage");
+    FreeImage_Initialise();
+    FreeImage_SetOutputMessage(my_freeimage_error);
+    freeimage_initialised = true;
+}
+
+void image_shutdown (void)
+{
+    if (!freeimage_initialised) return;
+    FreeImage_DeInitialise();
+    freeimage_initialised = false;
+}
 
 // supported values: <1,0>, <3,0>, <3,1>, <4,0>
 template<chan_t ch, chan_t ach> Image<ch,ach> *image_from_fibitmap (FIBITMAP *input, uimglen_t width, uimglen_t height)
@@ -248,6 +273,18 @@ template<> FIBITMAP *image_to_fibitmap (const Image<1,0> *image, uimglen_t width
 
 
 
+ImageBase *image_alloc (uimglen_t width, uimglen_t height, chan_t channels, bool alpha)
+{
+    switch (channels) {
+        case 1: if (alpha) break; return new Image<1,0>(width, height);
+        case 2: if (alpha) return new Image<1,1>(width, height); return new Image<2,0>(width, height);
+        case 3: if (alpha) return new Image<2,1>(width, height); return new Image<3,0>(width, height);
+        case 4: if (alpha) return new Image<3,1>(width, height); return new Image<4,0>(width, height);
+        default:;
+    }
+    EXCEPTEX << "Unsupported image format: " << int(channels) << " channels" << (alpha ? " with alpha" : "") << ENDL;
+}
+
 ImageBase *image_load (const std::string &filename)
 {
     size_t dot = filename.rfind('.');
@@ -266,6 +303,8 @@ ImageBase *image_load (const std::string &filename)
 
     } else {
 
+        image_init();
+
         FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(filename.c_str(), 0);
         if (fif == FIF_UNKNOWN) {
             fif = FreeImage_GetFIFFromFilename(filename.c_str());
@@ -408,6 +447,8 @@ void image_save (ImageBase *image, const std::string &filename, const std::strin
 
     } else {
 
+        image_init();
+
         FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFilename(filename.c_str());
         if (fif == FIF_UNKNOWN) {
             EXCEPT << "Unknown format: " << ext << ENDL;
@@ -579,6 +620,8 @@ template<chan_t ch, chan_t ach> Image<ch,ach> *image_from_fifloat (FIBITMAP *img
 template<chan_t ch, chan_t ach>
 ImageBase *do_scale (const ImageBase *src, uimglen_t dst_width, uimglen_t dst_height, ScaleFilter filter)
 {
+    image_init();
+
     FIBITMAP *fib = image_to_fifloat<ch,ach>(src);
     
     FIBITMAP *scaled = FreeImage_Rescale(fib, dst_width, dst_height, to_fi(filter));
@@ -57,6 +57,7 @@ void HSVtoRGB (float H, float S, float L, float &R, float &G, float &B);
 #include <string>
 
 #include "dds.h"
+#include "parallel.h"
 
 static inline simglen_t mymod (simglen_t a, simglen_t b)
 {
@@ -421,39 +422,86 @@ template<chan_t ch, chan_t ach> class Image : public ImageBase {
     |            |            |
     -------------+-------------
 */
+    // Rotation by a whole number of quarter turns, as rotate would do it but without resampling.
+    // The output is walked in square tiles so that the transposed reads stay in cache.
+    Image<ch,ach> *rotateQuarters (unsigned quarters) const
+    {
+        quarters %= 4;
+        if (quarters == 0) return clone(false, false);
+        if (quarters == 2) return clone(true, true);
+        const uimglen_t tile = 32;
+        uimglen_t w = height, h = width;
+        Image<ch, ach> *ret = new Image<ch, ach>(w, h);
+        parallel_for((h + tile - 1) / tile, size_t(tile) * w, [&] (size_t begin, size_t end) {
+            for (uimglen_t y0=begin*tile ; y0<end*tile && y0<h ; y0+=tile) {
+                uimglen_t y1 = std::min(y0 + tile, h);
+                for (uimglen_t x0=0 ; x0<w ; x0+=tile) {
+                    uimglen_t x1 = std::min(x0 + tile, w);
+                    for (uimglen_t y=y0 ; y<y1 ; ++y) {
+                        for (uimglen_t x=x0 ; x<x1 ; ++x) {
+                            ret->pixel(x,y) = quarters == 1 ? this->pixel(width-1-y, x)
+                                                            : this->pixel(y, height-1-x);
+                        }
+                    }
+                }
+            }
+        });
+        return ret;
+    }
+
     Image<ch,ach> *rotate (float angle, const ColourBase *bg_) const
     {
-        // calculate these later
         Colour<ch,ach> bg(0);
         if (bg_ != NULL) bg = *static_cast<const Colour<ch,ach>*>(bg_);
+        if (fmodf(angle, 90) == 0) {
+            float quarters = fmodf(angle / 90, 4);
+            return rotateQuarters(unsigned(quarters < 0 ? quarters + 4 : quarters));
+        }
         float s = ::sin(angle*PI/180);
         float c = ::cos(angle*PI/180);
         uimglen_t w = (fabs(c)*width + fabs(s)*height + 0.5);
         uimglen_t h = (fabs(s)*width + fabs(c)*height + 0.5);
         Image<ch, ach> *ret = new Image<ch, ach>(w, h);
-        for (uimglen_t y=0 ; y<h; ++y) {
-            for (uimglen_t x=0 ; x<w; ++x) {
-                float rel_x = float(x) - w/2.0f + 0.5f; // 0.5
-                float rel_y = float(y) - h/2.0f + 0.5f; // -2 to 2
-                float src_x = c*rel_x - s*rel_y + width/2.0f; // 0.5
-                float src_y = s*rel_x + c*rel_y + height/2.0f; // 0.5 to 4.5
-                if (src_x>=0 && src_x<width && src_y>=0 && src_y<height) {
-                    src_x -= 0.5; // 0
-                    src_y -= 0.5; // 0 to 4
-                    Colour<ch,ach> c00 = this->pixelSafe(floorf(src_x+0), floorf(src_y+0), bg);
-                    Colour<ch,ach> c01 = this->pixelSafe(floorf(src_x+1), floorf(src_y+0), bg);
-                    Colour<ch,ach> c10 = this->pixelSafe(floorf(src_x+0), floorf(src_y+1), bg);
-                    Colour<ch,ach> c11 = this->pixelSafe(floorf(src_x+1), floorf(src_y+1), bg);
-                    float frac_x = src_x - floorf(src_x);
-                    float frac_y = src_y - floorf(src_y);
-                    Colour<ch,ach> c0x = colour_lerp(c00, c01, frac_x);
-                    Colour<ch,ach> c1x = colour_lerp(c10, c11, frac_x);
-                    ret->pixel(x,y) = colour_lerp(c0x, c1x, frac_y);
-                } else {
-                    ret->pixel(x,y) = bg;
+        // The source position moves by (c, s) per output pixel along a row, so it is stepped
+        // rather than recomputed, in double so it does not drift across wide rows.  Pixels
+        // whose 2x2 footprint is inside the source are read directly, only the edges need
+        // bounds checks.
+        parallel_for(h, w, [&] (size_t begin, size_t end) {
+            for (uimglen_t y=begin ; y<end ; ++y) {
+                float rel_x = 0.5f - w/2.0f;
+                float rel_y = float(y) - h/2.0f + 0.5f;
+                double src_x = c*rel_x - s*rel_y + width/2.0f;
+                double src_y = s*rel_x + c*rel_y + height/2.0f;
+                Colour<ch,ach> *out = &ret->pixel(0, y);
+                for (uimglen_t x=0 ; x<w ; ++x, src_x+=c, src_y+=s) {
+                    if (!(src_x>=0 && src_x<width && src_y>=0 && src_y<height)) {
+                        out[x] = bg;
+                        continue;
+                    }
+                    float sx = float(src_x) - 0.5f;
+                    float sy = float(src_y) - 0.5f;
+                    float fx = floorf(sx);
+                    float fy = floorf(sy);
+                    Colour<ch,ach> c00, c01, c10, c11;
+                    if (fx >= 0 && fy >= 0 && fx+1 < width && fy+1 < height) {
+                        const Colour<ch,ach> *row0 = &data[uimglen_t(fy)*width + uimglen_t(fx)];
+                        const Colour<ch,ach> *row1 = row0 + width;
+                        c00 = row0[0];
+                        c01 = row0[1];
+                        c10 = row1[0];
+                        c11 = row1[1];
+                    } else {
+                        c00 = this->pixelSafe(fx+0, fy+0, bg);
+                        c01 = this->pixelSafe(fx+1, fy+0, bg);
+                        c10 = this->pixelSafe(fx+0, fy+1, bg);
+                        c11 = this->pixelSafe(fx+1, fy+1, bg);
+                    }
+                    Colour<ch,ach> c0x = colour_lerp(c00, c01, sx - fx);
+                    Colour<ch,ach> c1x = colour_lerp(c10, c11, sx - fx);
+                    out[x] = colour_lerp(c0x, c1x, sy - fy);
                 }
             }
-        }
+        });
         return ret;
     }
 
@@ -486,33 +534,33 @@ template<chan_t ch, chan_t ach> class Image : public ImageBase {
 
     Image<ch,ach> *normalise (void) const
     {
-        Colour<ch,ach> pos_total(0.0f);
-        Colour<ch,ach> neg_total(0.0f);
-        for (uimglen_t y=0 ; y<height ; ++y) {
-            for (uimglen_t x=0 ; x<width ; ++x) {
+        // Totals of the positive values, then of the negated negative values.
+        double totals[2*(ch+ach)];
+        parallel_sum(numPixels(), 2*(ch+ach), ch+ach, [&] (size_t begin, size_t end, double *acc) {
+            for (size_t i=begin ; i<end ; ++i) {
                 for (chan_t c=0 ; c<ch+ach ; ++c) {
-                    float v = this->pixel(x,y)[c];
+                    float v = data[i][c];
                     if (v >= 0) {
-                        pos_total[c] += v;
+                        acc[c] += v;
                     } else {
-                        neg_total[c] -= v;
+                        acc[ch+ach+c] -= v;
                     }
                 }
             }
-        }
+        }, totals);
         Image<ch,ach> *ret = new Image<ch,ach>(width, height);
-        for (uimglen_t y=0 ; y<height ; ++y) {
-            for (uimglen_t x=0 ; x<width ; ++x) {
+        parallel_for(numPixels(), ch+ach, [&] (size_t begin, size_t end) {
+            for (size_t i=begin ; i<end ; ++i) {
                 for (chan_t c=0 ; c<ch+ach ; ++c) {
-                    float v = this->pixel(x,y)[c];
+                    float v = data[i][c];
                     if (v >= 0) {
-                        ret->pixel(x,y)[c] = v / pos_total[c];
+                        ret->data[i][c] = v / totals[c];
                     } else {
-                        ret->pixel(x,y)[c] = v / neg_total[c];
+                        ret->data[i][c] = v / totals[ch+ach+c];
                     }
                 }
             }
-        }
+        });
         return ret;
     }
 
@@ -855,66 +903,57 @@ Image<ch1,0> *image_blend_right_mask (T1 a, T2 b)
 }
 
 
-// TA and TB can be Image<ch,ach> or Colour<ch,ach>
-template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float), float rop(float,float), class T1, class T2> 
-ColourBase *image_zip_reduce_regular (T1 a, T2 b)
+// Sum zop(a[c], b[c]) over all pixels, via parallel_sum so it is accurate and deterministic.
+// ga and gb fetch the colour of each operand at a pixel (converting masks to n channels).
+template<chan_t ch, chan_t ach, float zop(float,float), class GA, class GB>
+ColourBase *image_zip_sum (uimglen_t width, uimglen_t height, GA ga, GB gb)
 {
-    if (ch1 != ch2) abort();
-    if (ach1 != ach2) abort();
-    uimglen_t width = get_width(a,b);
-    uimglen_t height = get_height(a,b);
-    Colour<ch1,ach1> *r = new Colour<ch1,ach1>(0);
-    for (uimglen_t y=0 ; y<height ; ++y) {
-        for (uimglen_t x=0 ; x<width ; ++x) {
-            Colour<ch1,ach1> ac = a->pixel(x,y);
-            Colour<ch2,ach2> bc = b->pixel(x,y);
-            for (chan_t c=0 ; c<ch1+ach1 ; ++c) {
-                float zr = zop(ac[c], bc[c]);
-                (*r)[c] = rop((*r)[c], zr);
+    double total[ch+ach];
+    parallel_sum(size_t(width) * height, ch+ach, ch+ach, [&] (size_t begin, size_t end, double *acc) {
+        uimglen_t x = begin % width;
+        uimglen_t y = begin / width;
+        for (size_t i=begin ; i<end ; ++i) {
+            const auto &ac = ga(x, y);
+            const auto &bc = gb(x, y);
+            for (chan_t c=0 ; c<ch+ach ; ++c) acc[c] += zop(ac[c], bc[c]);
+            if (++x == width) {
+                x = 0;
+                ++y;
             }
         }
-    }
+    }, total);
+    Colour<ch,ach> *r = new Colour<ch,ach>(0);
+    for (chan_t c=0 ; c<ch+ach ; ++c) (*r)[c] = total[c];
     return r;
 }
 
+// TA and TB can be Image<ch,ach> or Colour<ch,ach>
+template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float), class T1, class T2> 
+ColourBase *image_zip_sum_regular (T1 a, T2 b)
+{
+    if (ch1 != ch2) abort();
+    if (ach1 != ach2) abort();
+    return image_zip_sum<ch1,ach1,zop>(get_width(a,b), get_height(a,b),
+        [&] (uimglen_t x, uimglen_t y) { return a->pixel(x,y); },
+        [&] (uimglen_t x, uimglen_t y) { return b->pixel(x,y); });
+}
+
 // TA can be Image<1,0> or Colour<1,0>
-template<chan_t ch, chan_t ach, float zop(float,float), float rop(float,float), class T1, class T2> 
-ColourBase *image_zip_reduce_left_mask (T1 a, T2 b)
+template<chan_t ch, chan_t ach, float zop(float,float), class T1, class T2> 
+ColourBase *image_zip_sum_left_mask (T1 a, T2 b)
 {
-    uimglen_t width = get_width(a,b);
-    uimglen_t height = get_height(a,b);
-    Colour<ch,ach> *r = new Colour<ch,ach>(0);
-    for (uimglen_t y=0 ; y<height ; ++y) {
-        for (uimglen_t x=0 ; x<width ; ++x) {
-            Colour<ch,ach> ac = Colour<ch,ach>(a->pixel(x,y)[0]);
-            Colour<ch,ach> bc = b->pixel(x,y);
-            for (chan_t c=0 ; c<ch+ach ; ++c) {
-                float zr = zop(ac[c], bc[c]);
-                (*r)[c] = rop((*r)[c], zr);
-            }
-        }
-    }
-    return r;
+    return image_zip_sum<ch,ach,zop>(get_width(a,b), get_height(a,b),
+        [&] (uimglen_t x, uimglen_t y) { return Colour<ch,ach>(a->pixel(x,y)[0]); },
+        [&] (uimglen_t x, uimglen_t y) { return b->pixel(x,y); });
 }
 
 // TB can be Image<1,0> or Colour<1,0>
-template<chan_t ch, chan_t ach, float zop(float,float), float rop(float,float), class T1, class T2> 
-ColourBase *image_zip_reduce_right_mask (T1 a, T2 b)
+template<chan_t ch, chan_t ach, float zop(float,float), class T1, class T2> 
+ColourBase *image_zip_sum_right_mask (T1 a, T2 b)
 {
-    uimglen_t width = get_width(a,b);
-    uimglen_t height = get_height(a,b);
-    Colour<ch,ach> *r = new Colour<ch,ach>(0);
-    for (uimglen_t y=0 ; y<height ; ++y) {
-        for (uimglen_t x=0 ; x<width ; ++x) {
-            Colour<ch,ach> ac = a->pixel(x,y);
-            Colour<ch,ach> bc = Colour<ch,ach>(b->pixel(x,y)[0]);
-            for (chan_t c=0 ; c<ch+ach ; ++c) {
-                float zr = zop(ac[c], bc[c]);
-                (*r)[c] = rop((*r)[c], zr);
-            }
-        }
-    }
-    return r;
+    return image_zip_sum<ch,ach,zop>(get_width(a,b), get_height(a,b),
+        [&] (uimglen_t x, uimglen_t y) { return a->pixel(x,y); },
+        [&] (uimglen_t x, uimglen_t y) { return Colour<ch,ach>(b->pixel(x,y)[0]); });
 }
 
 
@@ -993,6 +1032,17 @@ Colour<ch1,ach1> global_lerp_colour_right_mask (const Colour<ch1,ach1> *a, const
 
 
 
+/** Initialise FreeImage, if not already done.  This happens automatically the
+ * first time it is needed, so calling it is only necessary to control when the
+ * cost is paid (e.g. before forking worker processes). */
+void image_init (void);
+
+void image_shutdown (void);
+
+/** Allocate an image (uninitialised) with the given number of channels,
+ * including the alpha channel if there is one. */
+ImageBase *image_alloc (uimglen_t width, uimglen_t height, chan_t channels, bool alpha);
+
 ImageBase *image_load (const std::string &filename);
 
 void image_save (ImageBase *image, const std::string &filename, const std::string &type);
@@ -0,0 +1,82 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "integral.h"
+#include "parallel.h"
+
+IntegralImage::IntegralImage (const ImageBase *src)
+  : table((size_t(src->width) + 1) * (size_t(src->height) + 1) * src->channels(), 0.0),
+    width(src->width), height(src->height), channels(src->channels())
+{
+    const float *in = src->raw();
+    size_t stride = (size_t(width) + 1) * channels;
+
+    // Prefix sums along each row, into row y+1 of the table.
+    parallel_for(height, size_t(width) * channels, [&] (size_t begin, size_t end) {
+        for (size_t y=begin ; y<end ; ++y) {
+            const float *src_row = &in[y * width * channels];
+            double *row = &table[(y + 1) * stride];
+            for (size_t x=0 ; x<width ; ++x) {
+                for (chan_t c=0 ; c<channels ; ++c)
+                    row[(x + 1) * channels + c] = row[x * channels + c] + src_row[x * channels + c];
+            }
+        }
+    });
+
+    // Prefix sums down each column.  Each thread takes a range of columns and sweeps up the rows,
+    // so it still reads contiguous memory.
+    parallel_for(stride, height, [&] (size_t begin, size_t end) {
+        for (size_t y=1 ; y<height ; ++y) {
+            const double *below = &table[y * stride];
+            double *row = &table[(y + 1) * stride];
+            for (size_t i=begin ; i<end ; ++i) row[i] += below[i];
+        }
+    });
+}
+
+size_t IntegralImage::sum (simglen_t left, simglen_t bottom, uimglen_t w, uimglen_t h,
+                           double *out) const
+{
+    // Clip [left, left+w) x [bottom, bottom+h) to the image, in a wide type so it cannot overflow.
+    long long x0 = std::max<long long>(left, 0);
+    long long y0 = std::max<long long>(bottom, 0);
+    long long x1 = std::min<long long>((long long)left + w, width);
+    long long y1 = std::min<long long>((long long)bottom + h, height);
+    if (x1 <= x0 || y1 <= y0) {
+        for (chan_t c=0 ; c<channels ; ++c) out[c] = 0;
+        return 0;
+    }
+    const double *e00 = entry(x0, y0), *e10 = entry(x1, y0);
+    const double *e01 = entry(x0, y1), *e11 = entry(x1, y1);
+    for (chan_t c=0 ; c<channels ; ++c) out[c] = e11[c] - e10[c] - e01[c] + e00[c];
+    return size_t(x1 - x0) * size_t(y1 - y0);
+}
+
+size_t IntegralImage::mean (simglen_t left, simglen_t bottom, uimglen_t w, uimglen_t h,
+                            double *out) const
+{
+    size_t n = sum(left, bottom, w, h, out);
+    if (n > 0)
+        for (chan_t c=0 ; c<channels ; ++c) out[c] /= n;
+    return n;
+}
@@ -0,0 +1,69 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef INTEGRAL_H
+#define INTEGRAL_H
+
+#include <vector>
+
+#include "image.h"
+
+/** Summed-area table of an image, in double precision so that sums over large
+ * regions do not lose the low bits.  Any rectangular region can then be summed
+ * with 4 lookups per channel. */
+class IntegralImage {
+
+    // (width+1) by (height+1) entries of channels doubles.  Entry (x,y) is the sum of all pixels
+    // left of x and below y, so the first row and column are 0.
+    std::vector<double> table;
+
+    const double *entry (uimglen_t x, uimglen_t y) const
+    {
+        return &table[(size_t(y) * (width + 1) + x) * channels];
+    }
+
+    public:
+
+    const uimglen_t width, height;
+    const chan_t channels;
+
+    /** Build the table, in parallel: a prefix sum along each row, then down each column. */
+    IntegralImage (const ImageBase *src);
+
+    size_t numBytes (void) const { return table.size() * sizeof(double); }
+
+    /** Sum of each channel over the given region, clipped to the image.  Returns the number of
+     * pixels summed (0 if the region is entirely outside the image, in which case the sums are
+     * all 0). */
+    size_t sum (simglen_t left, simglen_t bottom, uimglen_t w, uimglen_t h, double *out) const;
+
+    /** Mean of each channel over the given region, clipped to the image.  Returns the number of
+     * pixels considered; if it is 0 the means are all 0. */
+    size_t mean (simglen_t left, simglen_t bottom, uimglen_t w, uimglen_t h, double *out) const;
+};
+
+static inline std::ostream &operator<<(std::ostream &o, const IntegralImage &img)
+{
+    o << "IntegralImage ("<<img.width<<","<<img.height<<")x"<<int(img.channels)<<" [0x"<<&img<<"]";
+    return o;
+}
+
+#endif
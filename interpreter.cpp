@@ -20,12 +20,26 @@
  */
 
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 
 #include <string>
 #include <vector>
+#include <sstream>
+#include <fstream>
 #include <iostream>
 
 #include <signal.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 extern "C" {
     #include "lua.h"
@@ -40,6 +54,7 @@ extern "C" {
 
 #include "interpreter.h"
 #include "lua_wrappers_image.h"
+#include "startup_profile.h"
 
 static lua_State *L;
 
@@ -69,6 +84,189 @@ static void interrupt_handler (int sig)
 
 static std::vector<std::string> no_args;
 
+
+///////////////////////////
+// COMPILED SCRIPT CACHE //
+///////////////////////////
+
+// Empty means no caching.
+static std::string cache_dir;
+
+void interpreter_set_cache_dir (const std::string &dir)
+{
+    cache_dir = dir;
+    if (cache_dir == "") return;
+    // Only create the last component, like mkdir without -p.
+    #ifdef WIN32
+    _mkdir(cache_dir.c_str());
+    #else
+    mkdir(cache_dir.c_str(), 0777);
+    #endif
+}
+
+// Every cache file begins with this, followed by the key, then the output of lua_dump.  The key
+// is the absolute path of the script and the chunk name, separated by a NUL.  The cached code is
+// only used if the key, mtime, size and hash of the source all match.
+struct CacheHeader {
+    uint64_t magic;
+    int64_t mtime;
+    uint64_t size;
+    uint64_t hash;
+    uint64_t keyLength;
+};
+
+static const uint64_t CACHE_MAGIC = 0x3143474d49415531ULL;  // changes if the format changes
+
+// FNV-1a, 64 bit
+static uint64_t cache_hash (const std::string &s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i=0 ; i<s.length() ; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static bool read_whole_file (const std::string &fname, std::string &contents)
+{
+    std::ifstream f(fname.c_str(), std::ios::binary);
+    if (!f.good()) return false;
+    std::stringstream ss;
+    ss << f.rdbuf();
+    if (f.bad()) return false;
+    contents = ss.str();
+    return true;
+}
+
+static std::string absolute_path (const std::string &fname)
+{
+    #ifdef WIN32
+    char *abs = _fullpath(NULL, fname.c_str(), 0);
+    #else
+    char *abs = realpath(fname.c_str(), NULL);
+    #endif
+    if (abs == NULL) return fname;
+    std::string r = abs;
+    free(abs);
+    return r;
+}
+
+struct LoadBuffer {
+    const char *data;
+    size_t size;
+};
+
+static const char *load_buffer_reader (lua_State *, void *ud, size_t *sz)
+{
+    LoadBuffer *buf = static_cast<LoadBuffer*>(ud);
+    if (buf->size == 0) return NULL;
+    *sz = buf->size;
+    buf->size = 0;
+    return buf->data;
+}
+
+static int dump_writer (lua_State *, const void *p, size_t sz, void *ud)
+{
+    static_cast<std::string*>(ud)->append(static_cast<const char*>(p), sz);
+    return 0;
+}
+
+static void write_cache_file (const std::string &cache_file, const CacheHeader &header, const std::string &key,
+                              const std::string &code)
+{
+    // Write to a temporary file and rename, so concurrent luaimg processes never see half a file.
+    std::stringstream tmp;
+    #ifdef WIN32
+    tmp << cache_file << ".tmp" << _getpid();
+    #else
+    tmp << cache_file << ".tmp" << getpid();
+    #endif
+    {
+        std::ofstream f(tmp.str().c_str(), std::ios::binary);
+        if (!f.good()) return;
+        f.write(reinterpret_cast<const char*>(&header), sizeof header);
+        f.write(key.data(), key.length());
+        f.write(code.data(), code.length());
+        if (!f.good()) {
+            f.close();
+            remove(tmp.str().c_str());
+            return;
+        }
+    }
+    #ifdef WIN32
+    // rename does not replace existing files on Windows.
+    remove(cache_file.c_str());
+    #endif
+    if (rename(tmp.str().c_str(), cache_file.c_str()) != 0) {
+        remove(tmp.str().c_str());
+    }
+}
+
+// Like luaL_loadfile, but uses compiled code from the cache directory if it is up to date, and
+// otherwise updates it.
+static int load_file (lua_State *L, const std::string &fname)
+{
+    if (cache_dir == "") return luaL_loadfile(L, fname.c_str());
+
+    std::string source;
+    struct stat st;
+    if (stat(fname.c_str(), &st) != 0 || !read_whole_file(fname, source)) {
+        // Let Lua report the error in the usual way.
+        return luaL_loadfile(L, fname.c_str());
+    }
+
+    std::string chunk_name = "@" + fname;
+    std::string key = absolute_path(fname);
+    key.push_back('\0');
+    key += chunk_name;
+
+    CacheHeader header;
+    header.magic = CACHE_MAGIC;
+    header.mtime = st.st_mtime;
+    header.size = source.length();
+    header.hash = cache_hash(source);
+    header.keyLength = key.length();
+
+    std::stringstream cache_file_ss;
+    cache_file_ss << cache_dir << "/" << std::hex << cache_hash(key) << ".luac";
+    std::string cache_file = cache_file_ss.str();
+
+    std::string cached;
+    if (read_whole_file(cache_file, cached) && cached.length() >= sizeof header + key.length()) {
+        CacheHeader cached_header;
+        memcpy(&cached_header, cached.data(), sizeof cached_header);
+        if (cached_header.magic == header.magic && cached_header.mtime == header.mtime
+            && cached_header.size == header.size && cached_header.hash == header.hash
+            && cached_header.keyLength == header.keyLength
+            && cached.compare(sizeof header, key.length(), key) == 0) {
+            size_t offset = sizeof header + key.length();
+            LoadBuffer buf = { cached.data() + offset, cached.length() - offset };
+            int status = lua_load(L, load_buffer_reader, &buf, chunk_name.c_str());
+            if (status == 0) return 0;
+            // Corrupt cache file, recompile and overwrite it.
+            lua_pop(L, 1);
+        }
+    }
+
+    // Skip a #! line as luaL_loadfile does, keeping the newline so line numbers are preserved.
+    if (source.length() > 0 && source[0] == '#') {
+        size_t nl = source.find('\n');
+        source.erase(0, nl == std::string::npos ? source.length() : nl);
+    }
+
+    LoadBuffer buf = { source.data(), source.length() };
+    int status = lua_load(L, load_buffer_reader, &buf, chunk_name.c_str());
+    if (status != 0) return status;
+
+    // STACK: [func]
+    std::string code;
+    if (lua_dump(L, dump_writer, &code) == 0) {
+        write_cache_file(cache_file, header, key, code);
+    }
+    return 0;
+}
+
 // Return codes;
 // 0 (success)
 // LUA_ERRRUN (runtime error -- an error message and stack has been printed)
@@ -110,7 +308,7 @@ static int execute_code (const std::vector<std::string> &args=no_args)
 
 bool interpreter_exec_file (const std::string &fname, const std::vector<std::string> &args)
 {
-    int status = luaL_loadfile(L, fname.c_str());
+    int status = load_file(L, fname);
 
     if (status == 0) {
         status = execute_code(args);
@@ -216,6 +414,31 @@ bool interpreter_exec_snippet (const std::string &str, const std::vector<std::st
     return true;
 }
 
+bool interpreter_exec_work (const Work &work, const std::vector<std::string> &args)
+{
+    unsigned snippet_counter = 0;
+    for (Work::const_iterator i=work.begin(),i_=work.end() ; i!=i_ ; ++i) {
+        switch (i->first) {
+            case F:
+            if (!interpreter_exec_file(i->second, args)) {
+                return false;
+            }
+            break;
+
+            case S: {
+                snippet_counter++;
+                std::stringstream ss;
+                ss << "[snippet" << snippet_counter << "]";
+                if (!interpreter_exec_snippet(i->second, args, ss.str())) {
+                    return false;
+                }
+            }
+            break;
+        }
+    }
+    return true;
+}
+
 
 void interpreter_exec_interactively (const std::string &prompt)
 {
@@ -306,7 +529,7 @@ static int global_include (lua_State *L)
     lua_pushcfunction(L, my_lua_error_handler_cerr);
     int error_handler = lua_gettop(L);
 
-    int status = luaL_loadfile(L, filename.c_str());
+    int status = load_file(L, filename);
     if (status) {
         const char *str = lua_tostring(L,-1);
         // call error function manually, lua will not do this for us in lua_load
@@ -339,16 +562,25 @@ static const luaL_reg global[] = {
 };
 void interpreter_init (void)
 {
+    StartupPhase phase("interpreter");
+
     L = lua_open();
     if (L == NULL) {
         std::cerr << "Internal error: could not create Lua state." << std::endl;
         exit(EXIT_FAILURE);
     }       
 
-	luaL_openlibs(L); //opens all standart lua libs
+    {
+        StartupPhase sub("  Lua standard libraries");
+        luaL_openlibs(L); //opens all standart lua libs
+    }
 
-    // replace string functions with ICU versions
-    utf8_lua_init(L);
+    {
+        // Only registers the functions, ICU itself loads its data the first time they are used.
+        StartupPhase sub("  ICU string functions");
+        // replace string functions with ICU versions
+        utf8_lua_init(L);
+    }
 
     // Move all members of math to the top level (i.e. become global funtions, vars, etc)
     lua_pushglobaltable(L);
@@ -373,7 +605,10 @@ void interpreter_init (void)
 
     lua_gc(L, LUA_GCSETSTEPMUL, 100000000);
 
-    lua_wrappers_image_init(L);
+    {
+        StartupPhase sub("  image bindings");
+        lua_wrappers_image_init(L);
+    }
 }
 
 void interpreter_shutdown (void)
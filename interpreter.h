@@ -30,10 +30,20 @@ void interpreter_shutdown (void);
 
 void interpreter_interrupt_probe (void);
 
+/** Cache compiled scripts (from -f and include) in the given directory, or disable caching if
+ * empty.  A cached script is used only if its path, mtime and content hash still match. */
+void interpreter_set_cache_dir (const std::string &dir);
+
 bool interpreter_exec_file (const std::string &fname, const std::vector<std::string> &args);
 
 bool interpreter_exec_snippet (const std::string &str, const std::vector<std::string> &args, const std::string &name);
 
 void interpreter_exec_interactively (const std::string &prompt);
 
+enum FileOrSnippet { F, S };
+typedef std::vector<std::pair<FileOrSnippet,std::string>> Work;
+
+/** Execute the files and snippets in sequence, stopping at the first one that fails. */
+bool interpreter_exec_work (const Work &work, const std::vector<std::string> &args);
+
 #endif
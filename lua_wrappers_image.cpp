@@ -42,6 +42,21 @@ extern "C" {
 
 #include "image.h"
 #include "text.h"
+#include "blur.h"
+#include "colour_lut.h"
+#include "colour_map.h"
+#include "cubemap.h"
+#include "distance_transform.h"
+#include "histogram.h"
+#include "integral.h"
+#include "morphology.h"
+#include "normal_map.h"
+#include "quality.h"
+#include "rank_filter.h"
+#include "remap.h"
+#include "sampler.h"
+#include "stencil.h"
+#include "warp.h"
 #include "gif.h"
 //#include "VoxelImage.h"
 
@@ -676,90 +691,90 @@ static void global_lerp_lua1 (lua_State *L)
 }
 
 
-template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float), float rop(float, float), class T1, class T2>
-static ColourBase *image_zip_reduce_lua4 (lua_State *L, T1 v1, T2 v2)
+template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float), class T1, class T2>
+static ColourBase *image_zip_sum_lua4 (lua_State *L, T1 v1, T2 v2)
 {
     // implements (1) and (3) above
     if (ch1 == ch2 && ach1 == ach2)
-        return image_zip_reduce_regular<ch1, ach1, ch2, ach2, zop, rop, T1, T2>(v1, v2);
+        return image_zip_sum_regular<ch1, ach1, ch2, ach2, zop, T1, T2>(v1, v2);
     if (ch1 == 1 && ach1 == 0)
-        return image_zip_reduce_left_mask<ch2, ach2, zop, rop, T1, T2>(v1, v2);
+        return image_zip_sum_left_mask<ch2, ach2, zop, T1, T2>(v1, v2);
     if (ch2 == 1 && ach2 == 0)
-        return image_zip_reduce_right_mask<ch1, ach1, zop, rop, T1, T2>(v1, v2);
+        return image_zip_sum_right_mask<ch1, ach1, zop, T1, T2>(v1, v2);
     my_lua_error(L, "Image operation on incompatible images/colours.");
     return NULL;
 }
 
-template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float), float rop(float, float)>
-static ColourBase *image_zip_reduce_lua3 (lua_State *L, const Image<ch1,ach1> *v1, const Image<ch2,ach2> *v2)
+template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float)>
+static ColourBase *image_zip_sum_lua3 (lua_State *L, const Image<ch1,ach1> *v1, const Image<ch2,ach2> *v2)
 {
     // both are images, must check size, but no issue with amibiguous vec(...)
     if (!v1->sizeCompatibleWith(v2)) {
         my_lua_error(L, "Operations require images have the same dimensions.");
     }
-    return image_zip_reduce_lua4<ch1, ach1, ch2, ach2, zop, rop, const Image<ch1,ach1>*, const Image<ch2,ach2>*>(L, v1, v2);
+    return image_zip_sum_lua4<ch1, ach1, ch2, ach2, zop, const Image<ch1,ach1>*, const Image<ch2,ach2>*>(L, v1, v2);
     
 }
 
-template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float), float rop(float, float)>
-static ColourBase *image_zip_reduce_lua3 (lua_State *, const Colour<ch1,ach1> *, const Colour<ch2,ach2> *)
+template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float)>
+static ColourBase *image_zip_sum_lua3 (lua_State *, const Colour<ch1,ach1> *, const Colour<ch2,ach2> *)
 {
     abort();
     return NULL;
 }
 
-template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float), float rop(float, float)>
-static ColourBase *image_zip_reduce_lua3 (lua_State *L, const Image<ch1,ach1> *v1, const Colour<ch2,ach2> *v2)
+template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float)>
+static ColourBase *image_zip_sum_lua3 (lua_State *L, const Image<ch1,ach1> *v1, const Colour<ch2,ach2> *v2)
 {
     if (ch1+ach1 == ch2) {
         // redo the colour
         Colour<ch1, ach1> v2_;
         for (chan_t c=0 ; c<ch2 ; ++c) v2_[c] = (*v2)[c];
-        return image_zip_reduce_lua4<ch1, ach1, ch1, ach1, zop, rop, const Image<ch1,ach1>*, const Colour<ch1,ach1>*>(L, v1, &v2_);
+        return image_zip_sum_lua4<ch1, ach1, ch1, ach1, zop, const Image<ch1,ach1>*, const Colour<ch1,ach1>*>(L, v1, &v2_);
     } else {
-        return image_zip_reduce_lua4<ch1, ach1, ch2, ach2, zop, rop, const Image<ch1,ach1>*, const Colour<ch2,ach2>*>(L, v1, v2);
+        return image_zip_sum_lua4<ch1, ach1, ch2, ach2, zop, const Image<ch1,ach1>*, const Colour<ch2,ach2>*>(L, v1, v2);
     }
 }
 
-template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float), float rop(float, float)>
-static ColourBase *image_zip_reduce_lua3 (lua_State *L, const Colour<ch1,ach1> *v1, const Image<ch2,ach2> *v2)
+template<chan_t ch1, chan_t ach1, chan_t ch2, chan_t ach2, float zop(float,float)>
+static ColourBase *image_zip_sum_lua3 (lua_State *L, const Colour<ch1,ach1> *v1, const Image<ch2,ach2> *v2)
 {
     if (ch1 == ch2+ach2) {
         // redo the colour
         Colour<ch2, ach2> v1_;
         for (chan_t c=0 ; c<ch1 ; ++c) v1_[c] = (*v1)[c];
-        return image_zip_reduce_lua4<ch2, ach2, ch2, ach2, zop, rop, const Colour<ch2,ach2>*, const Image<ch2,ach2>*>(L, &v1_, v2);
+        return image_zip_sum_lua4<ch2, ach2, ch2, ach2, zop, const Colour<ch2,ach2>*, const Image<ch2,ach2>*>(L, &v1_, v2);
     } else {
-        return image_zip_reduce_lua4<ch1, ach1, ch2, ach2, zop, rop, const Colour<ch1,ach1>*, const Image<ch2,ach2>*>(L, v1, v2);
+        return image_zip_sum_lua4<ch1, ach1, ch2, ach2, zop, const Colour<ch1,ach1>*, const Image<ch2,ach2>*>(L, v1, v2);
     }
 }
 
-template<chan_t ch, chan_t ach, float zop(float,float), float rop(float, float), class TA>
-static ColourBase *image_zip_reduce_lua2 (lua_State *L, TA a, const ImageBase *&some_image)
+template<chan_t ch, chan_t ach, float zop(float,float), class TA>
+static ColourBase *image_zip_sum_lua2 (lua_State *L, TA a, const ImageBase *&some_image)
 {
     if (is_ptr(L, 2, IMAGE_TAG)) {
         const ImageBase *b = check_ptr<ImageBase>(L, 2, IMAGE_TAG);
         some_image = b;
         switch (b->channels()) {
             case 1:
-            return image_zip_reduce_lua3<ch,ach,1,0,zop,rop>(L, a, static_cast<const Image<1,0>*>(b));
+            return image_zip_sum_lua3<ch,ach,1,0,zop>(L, a, static_cast<const Image<1,0>*>(b));
             case 2:
             if (b->hasAlpha()) {
-                return image_zip_reduce_lua3<ch,ach,1,1,zop,rop>(L, a, static_cast<const Image<1,1>*>(b));
+                return image_zip_sum_lua3<ch,ach,1,1,zop>(L, a, static_cast<const Image<1,1>*>(b));
             } else {
-                return image_zip_reduce_lua3<ch,ach,2,0,zop,rop>(L, a, static_cast<const Image<2,0>*>(b));
+                return image_zip_sum_lua3<ch,ach,2,0,zop>(L, a, static_cast<const Image<2,0>*>(b));
             }
             case 3:
             if (b->hasAlpha()) {
-                return image_zip_reduce_lua3<ch,ach,2,1,zop,rop>(L, a, static_cast<const Image<2,1>*>(b));
+                return image_zip_sum_lua3<ch,ach,2,1,zop>(L, a, static_cast<const Image<2,1>*>(b));
             } else {
-                return image_zip_reduce_lua3<ch,ach,3,0,zop,rop>(L, a, static_cast<const Image<3,0>*>(b));
+                return image_zip_sum_lua3<ch,ach,3,0,zop>(L, a, static_cast<const Image<3,0>*>(b));
             }
             case 4:
             if (b->hasAlpha()) {
-                return image_zip_reduce_lua3<ch,ach,3,1,zop,rop>(L, a, static_cast<const Image<3,1>*>(b));
+                return image_zip_sum_lua3<ch,ach,3,1,zop>(L, a, static_cast<const Image<3,1>*>(b));
             } else {
-                return image_zip_reduce_lua3<ch,ach,4,0,zop,rop>(L, a, static_cast<const Image<4,0>*>(b));
+                return image_zip_sum_lua3<ch,ach,4,0,zop>(L, a, static_cast<const Image<4,0>*>(b));
             }
 
             default: my_lua_error(L, "Internal error, strange number of channels.");
@@ -770,25 +785,25 @@ static ColourBase *image_zip_reduce_lua2 (lua_State *L, TA a, const ImageBase *&
         case 1: {
             Colour<1,0> colour;
             if (!check_colour(L,colour,2)) return NULL;
-            return image_zip_reduce_lua3<ch,ach,1,0,zop,rop>(L, a, &colour);
+            return image_zip_sum_lua3<ch,ach,1,0,zop>(L, a, &colour);
         }
 
         case 2: {
             Colour<2,0> colour;
             if (!check_colour(L,colour,2)) return NULL;
-            return image_zip_reduce_lua3<ch,ach,2,0,zop,rop>(L, a, &colour);
+            return image_zip_sum_lua3<ch,ach,2,0,zop>(L, a, &colour);
         }
 
         case 3: {
             Colour<3,0> colour;
             if (!check_colour(L,colour,2)) return NULL;
-            return image_zip_reduce_lua3<ch,ach,3,0,zop,rop>(L, a, &colour);
+            return image_zip_sum_lua3<ch,ach,3,0,zop>(L, a, &colour);
         }
 
         case 4: {
             Colour<4,0> colour;
             if (!check_colour(L,colour,2)) return NULL;
-            return image_zip_reduce_lua3<ch,ach,4,0,zop,rop>(L, a, &colour);
+            return image_zip_sum_lua3<ch,ach,4,0,zop>(L, a, &colour);
         }
 
         default:
@@ -797,33 +812,36 @@ static ColourBase *image_zip_reduce_lua2 (lua_State *L, TA a, const ImageBase *&
     return NULL;
 }
 
-template<float zop(float,float), float rop(float, float)>
-static ColourBase *image_zip_reduce_lua1 (lua_State *L, const ImageBase *&some_image)
+template<float zop(float,float)>
+static ColourBase *image_zip_sum_lua1 (lua_State *L, const ImageBase *&some_image)
 {
     check_args(L,2);
+    some_image = NULL;
+    if (!is_ptr(L, 1, IMAGE_TAG) && !is_ptr(L, 2, IMAGE_TAG))
+        my_lua_error(L, "At least one argument should be an image.");
     if (is_ptr(L, 1, IMAGE_TAG)) {
         const ImageBase *a = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
         some_image = a;
         switch (a->channels()) {
             case 1:
-            return image_zip_reduce_lua2<1,0,zop,rop>(L, static_cast<const Image<1,0>*>(a), some_image);
+            return image_zip_sum_lua2<1,0,zop>(L, static_cast<const Image<1,0>*>(a), some_image);
             case 2:
             if (a->hasAlpha()) {
-                return image_zip_reduce_lua2<1,1,zop,rop>(L, static_cast<const Image<1,1>*>(a), some_image);
+                return image_zip_sum_lua2<1,1,zop>(L, static_cast<const Image<1,1>*>(a), some_image);
             } else {
-                return image_zip_reduce_lua2<2,0,zop,rop>(L, static_cast<const Image<2,0>*>(a), some_image);
+                return image_zip_sum_lua2<2,0,zop>(L, static_cast<const Image<2,0>*>(a), some_image);
             }
             case 3:
             if (a->hasAlpha()) {
-                return image_zip_reduce_lua2<2,1,zop,rop>(L, static_cast<const Image<2,1>*>(a), some_image);
+                return image_zip_sum_lua2<2,1,zop>(L, static_cast<const Image<2,1>*>(a), some_image);
             } else {
-                return image_zip_reduce_lua2<3,0,zop,rop>(L, static_cast<const Image<3,0>*>(a), some_image);
+                return image_zip_sum_lua2<3,0,zop>(L, static_cast<const Image<3,0>*>(a), some_image);
             }
             case 4:
             if (a->hasAlpha()) {
-                return image_zip_reduce_lua2<3,1,zop,rop>(L, static_cast<const Image<3,1>*>(a), some_image);
+                return image_zip_sum_lua2<3,1,zop>(L, static_cast<const Image<3,1>*>(a), some_image);
             } else {
-                return image_zip_reduce_lua2<4,0,zop,rop>(L, static_cast<const Image<4,0>*>(a), some_image);
+                return image_zip_sum_lua2<4,0,zop>(L, static_cast<const Image<4,0>*>(a), some_image);
             }
 
             default: my_lua_error(L, "Internal error, strange number of channels.");
@@ -834,25 +852,25 @@ static ColourBase *image_zip_reduce_lua1 (lua_State *L, const ImageBase *&some_i
         case 1: {
             Colour<1,0> colour;
             if (!check_colour(L,colour,1)) return nullptr;
-            return image_zip_reduce_lua2<1,0,zop,rop>(L, &colour, some_image);
+            return image_zip_sum_lua2<1,0,zop>(L, &colour, some_image);
         }
 
         case 2: {
             Colour<2,0> colour;
             if (!check_colour(L,colour,1)) return nullptr;
-            return image_zip_reduce_lua2<2,0,zop,rop>(L, &colour, some_image);
+            return image_zip_sum_lua2<2,0,zop>(L, &colour, some_image);
         }
 
         case 3: {
             Colour<3,0> colour;
             if (!check_colour(L,colour,1)) return nullptr;
-            return image_zip_reduce_lua2<3,0,zop,rop>(L, &colour, some_image);
+            return image_zip_sum_lua2<3,0,zop>(L, &colour, some_image);
         }
 
         case 4: {
             Colour<4,0> colour;
             if (!check_colour(L,colour,1)) return nullptr;
-            return image_zip_reduce_lua2<4,0,zop,rop>(L, &colour, some_image);
+            return image_zip_sum_lua2<4,0,zop>(L, &colour, some_image);
         }
 
         default:
@@ -1485,6 +1503,88 @@ HANDLE_BEGIN
 HANDLE_END
 }
 
+SampleFilter sample_filter_from_string (const std::string &s)
+{
+    if (s == "NEAREST") return SAMPLE_NEAREST;
+    if (s == "BILINEAR") return SAMPLE_BILINEAR;
+    if (s == "CATMULLROM") return SAMPLE_CATMULLROM;
+    EXCEPT << "Expected NEAREST, BILINEAR, or CATMULLROM.  Got: \"" << s << "\"" << ENDL;
+}
+
+SampleBorder sample_border_from_string (const std::string &s)
+{
+    if (s == "CLAMP") return SAMPLE_CLAMP;
+    if (s == "WRAP") return SAMPLE_WRAP;
+    if (s == "MIRROR") return SAMPLE_MIRROR;
+    if (s == "COLOUR") return SAMPLE_COLOUR;
+    EXCEPT << "Expected CLAMP, WRAP, MIRROR, or COLOUR.  Got: \"" << s << "\"" << ENDL;
+}
+
+// A 3x3 matrix as a table of 9 numbers in row-major order, or 6 for an affine transform (the
+// bottom row is then 0 0 1).
+static void check_matrix3x3 (lua_State *L, int index, double *m)
+{
+    if (!lua_istable(L, index))
+        my_lua_error(L, "Expected a table of 6 or 9 numbers for the matrix, got "+type_name(L,index));
+    int elements = luaL_getn(L, index);
+    if (elements != 6 && elements != 9)
+        my_lua_error(L, "Matrix table must have 6 or 9 elements, got "+str(elements));
+    m[6] = 0; m[7] = 0; m[8] = 1;
+    for (int i=0 ; i<elements ; ++i) {
+        lua_rawgeti(L, index, i+1);
+        if (lua_type(L, -1) != LUA_TNUMBER)
+            my_lua_error(L, "Matrix table contained bad type at index "+str(i+1)+": "+type_name(L,-1));
+        m[i] = lua_tonumber(L, -1);
+        lua_pop(L, 1);
+    }
+}
+
+static int image_warp (lua_State *L)
+{
+HANDLE_BEGIN
+    if (lua_gettop(L) != 5) check_args(L, 6);
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    double m[9];
+    check_matrix3x3(L, 2, m);
+    uimglen_t width, height;
+    check_coord(L, 3, width, height);
+    SampleFilter filter = sample_filter_from_string(luaL_checkstring(L, 4));
+    SampleBorder border = sample_border_from_string(luaL_checkstring(L, 5));
+    ColourBase *colour = NULL;
+    if (lua_gettop(L) == 6) colour = alloc_colour(L, self->channels(), self->hasAlpha(), 6);
+    ImageBase *out;
+    try {
+        out = warp(self, m, width, height, filter, border, colour);
+    } catch (...) {
+        delete colour;
+        throw;
+    }
+    delete colour;
+    push_image(L, out);
+    return 1;
+HANDLE_END
+}
+
+static int image_remap (lua_State *L)
+{
+HANDLE_BEGIN
+    bool wrap_x = false;
+    bool wrap_y = false;
+    switch (lua_gettop(L)) {
+        case 5: wrap_y = check_bool(L, 5); __attribute__((fallthrough));
+        case 4: wrap_x = check_bool(L, 4); __attribute__((fallthrough));
+        case 3: break;
+        default:
+        my_lua_error(L, "image_remap takes 3, 4, or 5 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    ImageBase *coords = check_ptr<ImageBase>(L, 2, IMAGE_TAG);
+    SampleFilter filter = sample_filter_from_string(luaL_checkstring(L, 3));
+    push_image(L, remap(self, coords, filter, wrap_x, wrap_y));
+    return 1;
+HANDLE_END
+}
+
 static int image_rotate (lua_State *L)
 {
     if (lua_gettop(L) == 2) {
@@ -1531,8 +1631,12 @@ static int image_mirror (lua_State *L)
 
 static int image_mean_diff (lua_State *L)
 {
-    const ImageBase *some_image;
-    ColourBase *value = image_zip_reduce_lua1<op_diff,op_add>(L, some_image);
+    const ImageBase *some_image = NULL;
+    ColourBase *value = image_zip_sum_lua1<op_diff>(L, some_image);
+    if (value == NULL || some_image == NULL) {
+        delete value;
+        my_lua_error(L, "Expected an image and an image or colour.");
+    }
     float num_pixels = some_image->numPixels();
     float *raw = (float*)value; // maybe UB in C++ (OK in C)
     for (chan_t c=0 ; c<some_image->channels() ; ++c) {
@@ -1545,8 +1649,12 @@ static int image_mean_diff (lua_State *L)
 
 static int image_rms_diff (lua_State *L)
 {
-    const ImageBase *some_image;
-    ColourBase *value = image_zip_reduce_lua1<op_diffsq,op_add>(L, some_image);
+    const ImageBase *some_image = NULL;
+    ColourBase *value = image_zip_sum_lua1<op_diffsq>(L, some_image);
+    if (value == NULL || some_image == NULL) {
+        delete value;
+        my_lua_error(L, "Expected an image and an image or colour.");
+    }
     float num_pixels = some_image->numPixels();
     float *raw = (float*)value; // maybe UB in C++ (OK in C)
     for (chan_t c=0 ; c<some_image->channels() ; ++c) {
@@ -1789,12 +1897,540 @@ static int image_convolve_sep (lua_State *L)
     return 1;
 }
 
-static int image_normalise (lua_State *L)
+static int image_normalise (lua_State *L)
+{
+    check_args(L,1);
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    push_image(L, self->normalise());
+    return 1;
+}
+
+static int image_sdf (lua_State *L)
+{
+HANDLE_BEGIN
+    float threshold = 0.5f;
+    switch (lua_gettop(L)) {
+        case 3: threshold = luaL_checknumber(L, 3); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "image_sdf takes 2 or 3 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    float spread = luaL_checknumber(L, 2);
+    if (spread < 0) my_lua_error(L, "Spread must not be negative.");
+    push_image(L, sdf_from_mask(self, threshold, spread));
+    return 1;
+HANDLE_END
+}
+
+static int image_distance_transform (lua_State *L)
+{
+HANDLE_BEGIN
+    float threshold = 0.5f;
+    switch (lua_gettop(L)) {
+        case 2: threshold = luaL_checknumber(L, 2); __attribute__((fallthrough));
+        case 1: break;
+        default:
+        my_lua_error(L, "image_distance_transform takes 1 or 2 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    push_image(L, distance_transform(self, threshold));
+    return 1;
+HANDLE_END
+}
+
+static int image_bleed (lua_State *L)
+{
+HANDLE_BEGIN
+    float max_distance = std::numeric_limits<float>::infinity();
+    switch (lua_gettop(L)) {
+        case 2: max_distance = luaL_checknumber(L, 2); __attribute__((fallthrough));
+        case 1: break;
+        default:
+        my_lua_error(L, "image_bleed takes 1 or 2 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    if (max_distance < 0) my_lua_error(L, "Distance must not be negative.");
+    push_image(L, alpha_bleed(self, max_distance));
+    return 1;
+HANDLE_END
+}
+
+// A radius is either a number (same in both axes) or a vector2.
+static void check_radius (lua_State *L, int index, uimglen_t &rx, uimglen_t &ry)
+{
+    if (lua_type(L, index) == LUA_TNUMBER) {
+        rx = ry = check_int(L, index, 0, std::numeric_limits<uimglen_t>::max());
+    } else {
+        check_coord(L, index, rx, ry);
+    }
+}
+
+static int image_box_blur (lua_State *L)
+{
+HANDLE_BEGIN
+    bool wrap_x = false;
+    bool wrap_y = false;
+    switch (lua_gettop(L)) {
+        case 4: wrap_y = check_bool(L, 4); __attribute__((fallthrough));
+        case 3: wrap_x = check_bool(L, 3); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "image_box_blur takes 2, 3, or 4 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    uimglen_t rx, ry;
+    check_radius(L, 2, rx, ry);
+    push_image(L, box_blur(self, rx, ry, wrap_x, wrap_y));
+    return 1;
+HANDLE_END
+}
+
+static int image_fast_gaussian (lua_State *L)
+{
+HANDLE_BEGIN
+    bool wrap_x = false;
+    bool wrap_y = false;
+    switch (lua_gettop(L)) {
+        case 4: wrap_y = check_bool(L, 4); __attribute__((fallthrough));
+        case 3: wrap_x = check_bool(L, 3); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "image_fast_gaussian takes 2, 3, or 4 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    float sx, sy;
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        sx = sy = luaL_checknumber(L, 2);
+    } else {
+        lua_checkvector2(L, 2, &sx, &sy);
+    }
+    if (sx < 0 || sy < 0) my_lua_error(L, "Sigma must not be negative.");
+    push_image(L, fast_gaussian(self, sx, sy, wrap_x, wrap_y));
+    return 1;
+HANDLE_END
+}
+
+NormalFilter normal_filter_from_string (const std::string &s)
+{
+    if (s == "CENTRAL") return NORMAL_CENTRAL;
+    if (s == "SOBEL") return NORMAL_SOBEL;
+    if (s == "SCHARR") return NORMAL_SCHARR;
+    EXCEPT << "Expected CENTRAL, SOBEL, or SCHARR.  Got: \"" << s << "\"" << ENDL;
+}
+
+static int image_height_to_normal (lua_State *L)
+{
+HANDLE_BEGIN
+    NormalFilter filter = NORMAL_SOBEL;
+    bool wrap_x = false;
+    bool wrap_y = false;
+    bool xy_only = false;
+    switch (lua_gettop(L)) {
+        case 6: xy_only = check_bool(L, 6); __attribute__((fallthrough));
+        case 5: wrap_y = check_bool(L, 5); __attribute__((fallthrough));
+        case 4: wrap_x = check_bool(L, 4); __attribute__((fallthrough));
+        case 3: filter = normal_filter_from_string(luaL_checkstring(L, 3)); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "image_height_to_normal takes 2 to 6 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    float strength = luaL_checknumber(L, 2);
+    push_image(L, height_to_normal(self, strength, filter, wrap_x, wrap_y, xy_only));
+    return 1;
+HANDLE_END
+}
+
+// stencil(radius, kernel, iterations, [wrap_x, [wrap_y]]) where kernel is MEAN, MIN, MAX,
+// EXPAND, a life-like rule such as "B3/S23", or an image of weights.
+static int image_stencil (lua_State *L)
+{
+HANDLE_BEGIN
+    bool wrap_x = false;
+    bool wrap_y = false;
+    switch (lua_gettop(L)) {
+        case 6: wrap_y = check_bool(L, 6); __attribute__((fallthrough));
+        case 5: wrap_x = check_bool(L, 5); __attribute__((fallthrough));
+        case 4: break;
+        default:
+        my_lua_error(L, "image_stencil takes 4, 5, or 6 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    StencilKernel k;
+    check_radius(L, 2, k.rx, k.ry);
+    if (lua_type(L, 3) == LUA_TSTRING) {
+        std::string op = lua_tostring(L, 3);
+        if (op == "MEAN") {
+            k.op = STENCIL_MEAN;
+        } else if (op == "MIN") {
+            k.op = STENCIL_MIN;
+        } else if (op == "MAX") {
+            k.op = STENCIL_MAX;
+        } else if (op == "EXPAND") {
+            k.op = STENCIL_EXPAND;
+        } else {
+            stencil_parse_life(op, k);
+        }
+    } else {
+        ImageBase *weights = check_ptr<ImageBase>(L, 3, IMAGE_TAG);
+        if (weights->channels() != 1 || weights->hasAlpha())
+            my_lua_error(L, "Stencil weights must be a single channel image without alpha.");
+        if (weights->width != 2*k.rx + 1 || weights->height != 2*k.ry + 1)
+            my_lua_error(L, "Stencil weights must be (2*radius+1) in each dimension.");
+        k.op = STENCIL_LINEAR;
+        k.weights.assign(weights->raw(), weights->raw() + weights->numPixels());
+    }
+    unsigned iterations = check_int(L, 4, 0, std::numeric_limits<int>::max());
+    push_image(L, stencil(self, k, iterations, wrap_x, wrap_y));
+    return 1;
+HANDLE_END
+}
+
+LutInterpolation lut_interpolation_from_string (const std::string &s)
+{
+    if (s == "TRILINEAR") return LUT_TRILINEAR;
+    if (s == "TETRAHEDRAL") return LUT_TETRAHEDRAL;
+    EXCEPT << "Expected TRILINEAR or TETRAHEDRAL.  Got: \"" << s << "\"" << ENDL;
+}
+
+// applyLut(lut, [interpolation])
+static int image_apply_lut (lua_State *L)
+{
+HANDLE_BEGIN
+    LutInterpolation interp = LUT_TETRAHEDRAL;
+    switch (lua_gettop(L)) {
+        case 3: interp = lut_interpolation_from_string(luaL_checkstring(L, 3)); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "image_apply_lut takes 2 or 3 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    ColourLut *lut = check_ptr<ColourLut>(L, 2, LUT_TAG);
+    push_image(L, lut->apply(self, interp));
+    return 1;
+HANDLE_END
+}
+
+// Read a number or vector at index into c, returning how many channels it had.
+static chan_t check_stop_colour (lua_State *L, int index, float *c)
+{
+    switch (lua_type(L, index)) {
+        case LUA_TNUMBER: c[0] = lua_tonumber(L, index); return 1;
+        case LUA_TVECTOR2: lua_checkvector2(L, index, &c[0], &c[1]); return 2;
+        case LUA_TVECTOR3: lua_checkvector3(L, index, &c[0], &c[1], &c[2]); return 3;
+        case LUA_TVECTOR4: lua_checkvector4(L, index, &c[0], &c[1], &c[2], &c[3]); return 4;
+        default:
+        my_lua_error(L, "Gradient stop must be a number or vector, got "+type_name(L,index));
+        return 0;
+    }
+}
+
+// A table of colours (evenly spaced) or {position, colour} pairs.  Numbers are promoted to the
+// channels of the other stops.
+static ColourTable check_gradient_stops (lua_State *L, int index)
+{
+    int elements = luaL_getn(L, index);
+    if (elements == 0) my_lua_error(L, "Gradient table must have at least 1 stop.");
+    std::vector<float> positions(elements);
+    std::vector<float> raw(elements * 4);
+    std::vector<chan_t> chans(elements);
+    chan_t channels = 1;
+    for (int i=0 ; i<elements ; ++i) {
+        lua_rawgeti(L, index, i+1);
+        if (lua_istable(L, -1)) {
+            int pair = lua_gettop(L);
+            lua_rawgeti(L, pair, 1);
+            if (lua_type(L, -1) != LUA_TNUMBER)
+                my_lua_error(L, "Gradient stop "+str(i+1)+" position must be a number, got "+type_name(L,-1));
+            positions[i] = lua_tonumber(L, -1);
+            lua_rawgeti(L, pair, 2);
+            chans[i] = check_stop_colour(L, -1, &raw[i*4]);
+            lua_pop(L, 2);
+        } else {
+            positions[i] = elements == 1 ? 0 : float(i) / (elements - 1);
+            chans[i] = check_stop_colour(L, -1, &raw[i*4]);
+        }
+        lua_pop(L, 1);
+        channels = std::max(channels, chans[i]);
+    }
+    std::vector<float> colours(elements * channels);
+    for (int i=0 ; i<elements ; ++i) {
+        if (chans[i] != 1 && chans[i] != channels)
+            my_lua_error(L, "Gradient stop "+str(i+1)+" has "+str(int(chans[i]))+" channels, expected "+str(int(channels)));
+        for (chan_t k=0 ; k<channels ; ++k)
+            colours[i*channels + k] = raw[i*4 + (chans[i] == 1 ? 0 : k)];
+    }
+    return colour_table_from_stops(positions, colours, channels);
+}
+
+// colourMap(gradient, [range]) where gradient is an image or a table of stops.
+static int image_colour_map (lua_State *L)
+{
+HANDLE_BEGIN
+    float lo = 0, hi = 1;
+    switch (lua_gettop(L)) {
+        case 3: lua_checkvector2(L, 3, &lo, &hi); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "image_colour_map takes 2 or 3 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    ColourTable table;
+    if (lua_istable(L, 2)) {
+        table = check_gradient_stops(L, 2);
+    } else {
+        table = colour_table_from_image(check_ptr<ImageBase>(L, 2, IMAGE_TAG));
+    }
+    push_image(L, colour_map(self, table, lo, hi));
+    return 1;
+HANDLE_END
+}
+
+CurveInterp curve_interp_from_string (const std::string &s)
+{
+    if (s == "LINEAR") return CURVE_LINEAR;
+    if (s == "CUBIC") return CURVE_CUBIC;
+    if (s == "MONOTONE") return CURVE_MONOTONE;
+    EXCEPT << "Expected LINEAR, CUBIC, or MONOTONE.  Got: \"" << s << "\"" << ENDL;
+}
+
+// curve(points, [interp]) where points is a table of vector2.
+static int image_curve (lua_State *L)
+{
+HANDLE_BEGIN
+    CurveInterp interp = CURVE_MONOTONE;
+    switch (lua_gettop(L)) {
+        case 3: interp = curve_interp_from_string(luaL_checkstring(L, 3)); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "image_curve takes 2 or 3 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    if (!lua_istable(L, 2))
+        my_lua_error(L, "Expected a table of vector2 for the curve points, got "+type_name(L,2));
+    int elements = luaL_getn(L, 2);
+    std::vector<float> xs(elements), ys(elements);
+    for (int i=0 ; i<elements ; ++i) {
+        lua_rawgeti(L, 2, i+1);
+        if (lua_type(L, -1) != LUA_TVECTOR2)
+            my_lua_error(L, "Curve points table contained bad type at index "+str(i+1)+": "+type_name(L,-1));
+        lua_checkvector2(L, -1, &xs[i], &ys[i]);
+        lua_pop(L, 1);
+    }
+    push_image(L, curve(self, xs, ys, interp));
+    return 1;
+HANDLE_END
+}
+
+template<ImageBase *(*f)(const ImageBase *, uimglen_t, uimglen_t)>
+static int image_morph (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L, 2);
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    uimglen_t rx, ry;
+    check_radius(L, 2, rx, ry);
+    push_image(L, f(self, rx, ry));
+    return 1;
+HANDLE_END
+}
+
+static int image_histogram (lua_State *L)
+{
+HANDLE_BEGIN
+    float lo = 0, hi = 1;
+    switch (lua_gettop(L)) {
+        case 3: lua_checkvector2(L, 3, &lo, &hi); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "image_histogram takes 2 or 3 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    unsigned bins = check_int(L, 2, 1, 1 << 24);
+    std::vector<uint64_t> counts = histogram_count(self, bins, lo, hi);
+    lua_createtable(L, self->channels(), 0);
+    for (chan_t c=0 ; c<self->channels() ; ++c) {
+        lua_createtable(L, bins, 0);
+        for (unsigned b=0 ; b<bins ; ++b) {
+            lua_pushnumber(L, counts[size_t(c)*bins + b]);
+            lua_rawseti(L, -2, b + 1);
+        }
+        lua_rawseti(L, -2, c + 1);
+    }
+    return 1;
+HANDLE_END
+}
+
+static int image_percentile (lua_State *L)
+{
+    check_args(L,2);
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    float p = luaL_checknumber(L, 2);
+    if (p < 0 || p > 100) my_lua_error(L, "Percentile must be between 0 and 100.");
+    float r[4];
+    histogram_percentile(self, p, r);
+    switch (self->channels()) {
+        case 1: lua_pushnumber(L, r[0]); break;
+        case 2: lua_pushvector2(L, r[0], r[1]); break;
+        case 3: lua_pushvector3(L, r[0], r[1], r[2]); break;
+        case 4: lua_pushvector4(L, r[0], r[1], r[2], r[3]); break;
+        default: my_lua_error(L, "Internal error: weird channels");
+    }
+    return 1;
+}
+
+static int image_equalise (lua_State *L)
+{
+    check_args(L,1);
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    push_image(L, histogram_equalise(self));
+    return 1;
+}
+
+static int image_auto_levels (lua_State *L)
+{
+    float low = 0.5f, high = 99.5f;
+    switch (lua_gettop(L)) {
+        case 3:
+        low = luaL_checknumber(L, 2);
+        high = luaL_checknumber(L, 3);
+        break;
+        case 1: break;
+        default:
+        my_lua_error(L, "image_auto_levels takes 1 or 3 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    if (low < 0 || high > 100 || low > high)
+        my_lua_error(L, "Expected percentiles with 0 <= low <= high <= 100.");
+    push_image(L, histogram_auto_levels(self, low, high));
+    return 1;
+}
+
+void push_integral (lua_State *L, IntegralImage *self)
+{
+    ASSERT(self != NULL);
+    void **self_ptr = static_cast<void**>(lua_newuserdata(L, sizeof(*self_ptr)));
+    lua_extmemburden(L, self->numBytes());
+    *self_ptr = self;
+    luaL_getmetatable(L, INTEGRAL_TAG);
+    lua_setmetatable(L, -2);
+}
+
+static int integral_gc (lua_State *L)
+{
+    check_args(L, 1);
+    IntegralImage *self = check_ptr<IntegralImage>(L, 1, INTEGRAL_TAG);
+    lua_extmemburden(L, -(long)self->numBytes());
+    delete self;
+    return 0;
+}
+
+static int integral_eq (lua_State *L)
+{
+    check_args(L, 2);
+    IntegralImage *self = check_ptr<IntegralImage>(L, 1, INTEGRAL_TAG);
+    IntegralImage *that = check_ptr<IntegralImage>(L, 2, INTEGRAL_TAG);
+    lua_pushboolean(L, self==that);
+    return 1;
+}
+
+static int integral_tostring (lua_State *L)
+{
+    check_args(L,1);
+    IntegralImage *self = check_ptr<IntegralImage>(L, 1, INTEGRAL_TAG);
+    std::stringstream ss;
+    ss << *self;
+    push_string(L, ss.str());
+    return 1;
+}
+
+// sum(pos, size) and mean(pos, size), the region may extend beyond the image.
+template<size_t (IntegralImage::*f)(simglen_t, simglen_t, uimglen_t, uimglen_t, double *) const>
+static int integral_query (lua_State *L)
+{
+    check_args(L,3);
+    IntegralImage *self = check_ptr<IntegralImage>(L, 1, INTEGRAL_TAG);
+    float left, bottom;
+    lua_checkvector2(L, 2, &left, &bottom);
+    uimglen_t w, h;
+    check_coord(L, 3, w, h);
+    double r[4];
+    (self->*f)(simglen_t(floorf(left)), simglen_t(floorf(bottom)), w, h, r);
+    switch (self->channels) {
+        case 1: lua_pushnumber(L, r[0]); break;
+        case 2: lua_pushvector2(L, r[0], r[1]); break;
+        case 3: lua_pushvector3(L, r[0], r[1], r[2]); break;
+        case 4: lua_pushvector4(L, r[0], r[1], r[2], r[3]); break;
+        default: my_lua_error(L, "Internal error: weird channels");
+    }
+    return 1;
+}
+
+static int integral_index (lua_State *L)
+{
+    check_args(L,2);
+    IntegralImage *self = check_ptr<IntegralImage>(L, 1, INTEGRAL_TAG);
+    const char *key = luaL_checkstring(L, 2);
+    if (!::strcmp(key, "width")) {
+        lua_pushnumber(L, self->width);
+    } else if (!::strcmp(key, "height")) {
+        lua_pushnumber(L, self->height);
+    } else if (!::strcmp(key, "size")) {
+        lua_pushvector2(L, self->width, self->height);
+    } else if (!::strcmp(key, "channels")) {
+        lua_pushnumber(L, self->channels);
+    } else if (!::strcmp(key, "sum")) {
+        lua_pushcfunction(L, integral_query<&IntegralImage::sum>);
+    } else if (!::strcmp(key, "mean")) {
+        lua_pushcfunction(L, integral_query<&IntegralImage::mean>);
+    } else {
+        my_lua_error(L, "Not a readable IntegralImage field: \""+std::string(key)+"\"");
+    }
+    return 1;
+}
+
+const luaL_reg integral_meta_table[] = {
+    {"__tostring", integral_tostring},
+    {"__gc",       integral_gc},
+    {"__index",    integral_index},
+    {"__eq",       integral_eq},
+
+    {NULL, NULL}
+};
+
+static int image_integral (lua_State *L)
+{
+    check_args(L,1);
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    push_integral(L, new IntegralImage(self));
+    return 1;
+}
+
+static int image_median (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L, 2);
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    uimglen_t rx, ry;
+    check_radius(L, 2, rx, ry);
+    push_image(L, rank_filter(self, rx, ry, 50));
+    return 1;
+HANDLE_END
+}
+
+static int image_rank (lua_State *L)
 {
-    check_args(L,1);
+HANDLE_BEGIN
+    check_args(L, 3);
     ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
-    push_image(L, self->normalise());
+    uimglen_t rx, ry;
+    check_radius(L, 2, rx, ry);
+    float p = luaL_checknumber(L, 3);
+    if (p < 0 || p > 100) my_lua_error(L, "Percentile must be between 0 and 100.");
+    push_image(L, rank_filter(self, rx, ry, p));
     return 1;
+HANDLE_END
 }
 
 DitherAlgorithm dither_algorithm_from_string (const std::string &s)
@@ -1905,6 +2541,10 @@ static int image_index (lua_State *L)
         lua_pushcfunction(L, image_scale_by);
     } else if (!::strcmp(key, "rotate")) {
         lua_pushcfunction(L, image_rotate);
+    } else if (!::strcmp(key, "warp")) {
+        lua_pushcfunction(L, image_warp);
+    } else if (!::strcmp(key, "remap")) {
+        lua_pushcfunction(L, image_remap);
     } else if (!::strcmp(key, "clone")) {
         lua_pushcfunction(L, image_clone);
     } else if (!::strcmp(key, "flip")) {
@@ -1929,10 +2569,52 @@ static int image_index (lua_State *L)
         lua_pushcfunction(L, image_convolve);
     } else if (!::strcmp(key, "convolveSep")) {
         lua_pushcfunction(L, image_convolve_sep);
+    } else if (!::strcmp(key, "median")) {
+        lua_pushcfunction(L, image_median);
+    } else if (!::strcmp(key, "rank")) {
+        lua_pushcfunction(L, image_rank);
+    } else if (!::strcmp(key, "boxBlur")) {
+        lua_pushcfunction(L, image_box_blur);
+    } else if (!::strcmp(key, "fastGaussian")) {
+        lua_pushcfunction(L, image_fast_gaussian);
+    } else if (!::strcmp(key, "heightToNormal")) {
+        lua_pushcfunction(L, image_height_to_normal);
+    } else if (!::strcmp(key, "stencil")) {
+        lua_pushcfunction(L, image_stencil);
+    } else if (!::strcmp(key, "applyLut")) {
+        lua_pushcfunction(L, image_apply_lut);
+    } else if (!::strcmp(key, "colourMap")) {
+        lua_pushcfunction(L, image_colour_map);
+    } else if (!::strcmp(key, "curve")) {
+        lua_pushcfunction(L, image_curve);
     } else if (!::strcmp(key, "normalise")) {
         lua_pushcfunction(L, image_normalise);
     } else if (!::strcmp(key, "quantise")) {
         lua_pushcfunction(L, image_quantise);
+    } else if (!::strcmp(key, "sdf")) {
+        lua_pushcfunction(L, image_sdf);
+    } else if (!::strcmp(key, "histogram")) {
+        lua_pushcfunction(L, image_histogram);
+    } else if (!::strcmp(key, "percentile")) {
+        lua_pushcfunction(L, image_percentile);
+    } else if (!::strcmp(key, "equalise")) {
+        lua_pushcfunction(L, image_equalise);
+    } else if (!::strcmp(key, "autoLevels")) {
+        lua_pushcfunction(L, image_auto_levels);
+    } else if (!::strcmp(key, "integral")) {
+        lua_pushcfunction(L, image_integral);
+    } else if (!::strcmp(key, "distanceTransform")) {
+        lua_pushcfunction(L, image_distance_transform);
+    } else if (!::strcmp(key, "bleed")) {
+        lua_pushcfunction(L, image_bleed);
+    } else if (!::strcmp(key, "erode")) {
+        lua_pushcfunction(L, image_morph<morph_erode>);
+    } else if (!::strcmp(key, "dilate")) {
+        lua_pushcfunction(L, image_morph<morph_dilate>);
+    } else if (!::strcmp(key, "open")) {
+        lua_pushcfunction(L, image_morph<morph_open>);
+    } else if (!::strcmp(key, "close")) {
+        lua_pushcfunction(L, image_morph<morph_close>);
     } else if (!::strcmp(key, "draw")) {
         lua_pushcfunction(L, image_draw);
     } else if (!::strcmp(key, "drawLine")) {
@@ -2356,6 +3038,64 @@ HANDLE_BEGIN
 HANDLE_END
 }
 
+static int global_text_codepoint_sdf (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L,4);
+    std::string font = luaL_checkstring(L,1);
+    uimglen_t width, height;
+    check_coord(L, 2, width, height);
+    std::string text = luaL_checkstring(L,3);
+    size_t i = 0;
+    unsigned long cp = decode_utf8(text, i);
+    if (i != text.size()-1) my_lua_error(L, "Only one character can be supplied to text_codepoint_sdf().");
+    float spread = luaL_checknumber(L,4);
+    if (spread < 0) my_lua_error(L, "Spread must not be negative.");
+    ImageBase *image = make_text_codepoint_sdf(font, width, height, cp, spread);
+    push_image(L, image);
+    return 1;
+HANDLE_END
+}
+
+static int global_psnr (lua_State *L)
+{
+HANDLE_BEGIN
+    float peak = 1;
+    switch (lua_gettop(L)) {
+        case 3: peak = luaL_checknumber(L, 3); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "psnr takes 2 or 3 arguments");
+    }
+    const ImageBase *a = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    const ImageBase *b = check_ptr<ImageBase>(L, 2, IMAGE_TAG);
+    lua_pushnumber(L, quality_psnr(a, b, peak));
+    return 1;
+HANDLE_END
+}
+
+static int global_ssim (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L,2);
+    const ImageBase *a = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    const ImageBase *b = check_ptr<ImageBase>(L, 2, IMAGE_TAG);
+    lua_pushnumber(L, quality_ssim(a, b));
+    return 1;
+HANDLE_END
+}
+
+static int global_ms_ssim (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L,2);
+    const ImageBase *a = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    const ImageBase *b = check_ptr<ImageBase>(L, 2, IMAGE_TAG);
+    lua_pushnumber(L, quality_ms_ssim(a, b));
+    return 1;
+HANDLE_END
+}
+
 static int global_text (lua_State *L)
 {
 HANDLE_BEGIN
@@ -2382,6 +3122,63 @@ HANDLE_BEGIN
 HANDLE_END
 }
 
+static int global_text_batch (lua_State *L)
+{
+HANDLE_BEGIN
+    if (lua_gettop(L) != 3) check_args(L,4);
+    std::string font = luaL_checkstring(L,1);
+    uimglen_t width, height;
+    check_coord(L, 2, width, height);
+    if (!lua_istable(L, 3)) {
+        my_lua_error(L, "text_batch() expects a table of strings as its 3rd parameter.");
+    }
+    std::vector<std::string> texts;
+    int elements = luaL_getn(L, 3);
+    for (int i=1 ; i<=elements ; ++i) {
+        lua_rawgeti(L, 3, i);
+        if (lua_type(L, -1) != LUA_TSTRING) {
+            my_lua_error(L, "text_batch() strings table contained bad type at index "+str(i)+": "+type_name(L,-1));
+        }
+        texts.push_back(lua_tostring(L, -1));
+        lua_pop(L, 1);
+    }
+
+    TextBatchOptions opts;
+    if (lua_gettop(L) == 4 && !lua_isnil(L, 4)) {
+        if (!lua_istable(L, 4)) {
+            my_lua_error(L, "text_batch() expects a table of options as its 4th parameter.");
+        }
+        lua_getfield(L, 4, "width");
+        if (!lua_isnil(L, -1)) opts.width = check_int(L, -1, 1, std::numeric_limits<uimglen_t>::max());
+        lua_pop(L, 1);
+        lua_getfield(L, 4, "padding");
+        if (!lua_isnil(L, -1)) opts.padding = check_int(L, -1, 0, 1024);
+        lua_pop(L, 1);
+        lua_getfield(L, 4, "power_of_two");
+        if (!lua_isnil(L, -1)) opts.powerOfTwo = check_bool(L, -1);
+        lua_pop(L, 1);
+    }
+
+    std::vector<TextBatchRect> rects;
+    ImageBase *image = make_text_batch(font, width, height, texts, opts, rects);
+    push_image(L, image);
+
+    lua_newtable(L);
+    int table_index = lua_gettop(L);
+    for (unsigned i=0 ; i<rects.size() ; ++i) {
+        lua_newtable(L);
+        lua_pushvector2(L, rects[i].x, rects[i].y);
+        lua_setfield(L, -2, "pos");
+        lua_pushvector2(L, rects[i].w, rects[i].h);
+        lua_setfield(L, -2, "size");
+        lua_pushvector2(L, rects[i].originX, rects[i].originY);
+        lua_setfield(L, -2, "origin");
+        lua_rawseti(L, table_index, i+1);
+    }
+    return 2;
+HANDLE_END
+}
+
 static int global_mipmaps (lua_State *L)
 {
 HANDLE_BEGIN
@@ -2418,6 +3215,28 @@ HANDLE_BEGIN
 HANDLE_END
 }
 
+static int global_normal_mipmaps (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L, 1);
+    ImageBase *last = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    unsigned counter = 1;
+    lua_newtable(L);
+    int table_index = lua_gettop(L);
+
+    lua_pushvalue(L, 1);
+    lua_rawseti(L, table_index, counter++);
+
+    while (last->width > 1 || last->height > 1) {
+        last = normal_halve(last);
+        push_image(L, last);
+        lua_rawseti(L, table_index, counter++);
+    }
+
+    return 1;
+HANDLE_END
+}
+
 static int get_squish_flags (lua_State *L, int tab)
 {
     unsigned args = lua_gettop(L);
@@ -2604,6 +3423,247 @@ HANDLE_BEGIN
 HANDLE_END
 }
 
+void push_sampler (lua_State *L, TextureSampler *self)
+{
+    ASSERT(self != NULL);
+    void **self_ptr = static_cast<void**>(lua_newuserdata(L, sizeof(*self_ptr)));
+    lua_extmemburden(L, self->numBytes());
+    *self_ptr = self;
+    luaL_getmetatable(L, SAMPLER_TAG);
+    lua_setmetatable(L, -2);
+}
+
+static int sampler_gc (lua_State *L)
+{
+    check_args(L, 1);
+    TextureSampler *self = check_ptr<TextureSampler>(L, 1, SAMPLER_TAG);
+    lua_extmemburden(L, -(long)self->numBytes());
+    delete self;
+    return 0;
+}
+
+static int sampler_eq (lua_State *L)
+{
+    check_args(L, 2);
+    TextureSampler *self = check_ptr<TextureSampler>(L, 1, SAMPLER_TAG);
+    TextureSampler *that = check_ptr<TextureSampler>(L, 2, SAMPLER_TAG);
+    lua_pushboolean(L, self==that);
+    return 1;
+}
+
+static int sampler_tostring (lua_State *L)
+{
+    check_args(L,1);
+    TextureSampler *self = check_ptr<TextureSampler>(L, 1, SAMPLER_TAG);
+    std::stringstream ss;
+    ss << *self;
+    push_string(L, ss.str());
+    return 1;
+}
+
+static void push_sample (lua_State *L, chan_t channels, const float *r)
+{
+    switch (channels) {
+        case 1: lua_pushnumber(L, r[0]); break;
+        case 2: lua_pushvector2(L, r[0], r[1]); break;
+        case 3: lua_pushvector3(L, r[0], r[1], r[2]); break;
+        case 4: lua_pushvector4(L, r[0], r[1], r[2], r[3]); break;
+        default: my_lua_error(L, "Internal error: weird channels");
+    }
+}
+
+static int sampler_sample (lua_State *L)
+{
+    float lod = 0;
+    switch (lua_gettop(L)) {
+        case 3: lod = luaL_checknumber(L, 3); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "sample takes 2 or 3 arguments");
+    }
+    TextureSampler *self = check_ptr<TextureSampler>(L, 1, SAMPLER_TAG);
+    float u, v;
+    lua_checkvector2(L, 2, &u, &v);
+    float r[4];
+    self->sample(u, v, lod, r);
+    push_sample(L, self->channels, r);
+    return 1;
+}
+
+static int sampler_sample_grad (lua_State *L)
+{
+    check_args(L, 4);
+    TextureSampler *self = check_ptr<TextureSampler>(L, 1, SAMPLER_TAG);
+    float u, v, dudx, dvdx, dudy, dvdy;
+    lua_checkvector2(L, 2, &u, &v);
+    lua_checkvector2(L, 3, &dudx, &dvdx);
+    lua_checkvector2(L, 4, &dudy, &dvdy);
+    float r[4];
+    self->sampleGrad(u, v, dudx, dvdx, dudy, dvdy, r);
+    push_sample(L, self->channels, r);
+    return 1;
+}
+
+static int sampler_sample_image (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L, 2);
+    TextureSampler *self = check_ptr<TextureSampler>(L, 1, SAMPLER_TAG);
+    ImageBase *uvs = check_ptr<ImageBase>(L, 2, IMAGE_TAG);
+    push_image(L, self->sampleImage(uvs));
+    return 1;
+HANDLE_END
+}
+
+static int sampler_index (lua_State *L)
+{
+    check_args(L,2);
+    TextureSampler *self = check_ptr<TextureSampler>(L, 1, SAMPLER_TAG);
+    const char *key = luaL_checkstring(L, 2);
+    if (!::strcmp(key, "width")) {
+        lua_pushnumber(L, self->width());
+    } else if (!::strcmp(key, "height")) {
+        lua_pushnumber(L, self->height());
+    } else if (!::strcmp(key, "size")) {
+        lua_pushvector2(L, self->width(), self->height());
+    } else if (!::strcmp(key, "channels")) {
+        lua_pushnumber(L, self->channels);
+    } else if (!::strcmp(key, "hasAlpha")) {
+        lua_pushboolean(L, self->alpha);
+    } else if (!::strcmp(key, "levels")) {
+        lua_pushnumber(L, self->numLevels());
+    } else if (!::strcmp(key, "sample")) {
+        lua_pushcfunction(L, sampler_sample);
+    } else if (!::strcmp(key, "sampleGrad")) {
+        lua_pushcfunction(L, sampler_sample_grad);
+    } else if (!::strcmp(key, "sampleImage")) {
+        lua_pushcfunction(L, sampler_sample_image);
+    } else {
+        my_lua_error(L, "Not a readable TextureSampler field: \""+std::string(key)+"\"");
+    }
+    return 1;
+}
+
+const luaL_reg sampler_meta_table[] = {
+    {"__tostring", sampler_tostring},
+    {"__gc",       sampler_gc},
+    {"__index",    sampler_index},
+    {"__eq",       sampler_eq},
+
+    {NULL, NULL}
+};
+
+// sampler(img_or_mips, {filter=..., wrap=..., aniso=...}), all options optional.
+static int global_sampler (lua_State *L)
+{
+HANDLE_BEGIN
+    if (lua_gettop(L) != 1) check_args(L, 2);
+    std::vector<ImageBase*> mips = get_image_vector(L, 1);
+    SampleFilter filter = SAMPLE_BILINEAR;
+    bool mip_linear = true;
+    SampleBorder border = SAMPLE_WRAP;
+    unsigned aniso = 1;
+    if (lua_gettop(L) == 2 && !lua_isnil(L, 2)) {
+        if (!lua_istable(L, 2)) {
+            my_lua_error(L, "sampler() expects a table of options as its 2nd parameter.");
+        }
+        lua_getfield(L, 2, "filter");
+        if (!lua_isnil(L, -1)) {
+            std::string f = luaL_checkstring(L, -1);
+            if (f == "TRILINEAR") {
+                filter = SAMPLE_BILINEAR;
+            } else {
+                filter = sample_filter_from_string(f);
+                mip_linear = false;
+            }
+        }
+        lua_pop(L, 1);
+        lua_getfield(L, 2, "wrap");
+        if (!lua_isnil(L, -1)) border = sample_border_from_string(luaL_checkstring(L, -1));
+        lua_pop(L, 1);
+        lua_getfield(L, 2, "aniso");
+        if (!lua_isnil(L, -1)) aniso = check_int(L, -1, 1, 16);
+        lua_pop(L, 1);
+    }
+    push_sampler(L, new TextureSampler(mips, filter, mip_linear, border, aniso));
+    return 1;
+HANDLE_END
+}
+
+void push_lut (lua_State *L, ColourLut *self)
+{
+    ASSERT(self != NULL);
+    void **self_ptr = static_cast<void**>(lua_newuserdata(L, sizeof(*self_ptr)));
+    lua_extmemburden(L, self->numBytes());
+    *self_ptr = self;
+    luaL_getmetatable(L, LUT_TAG);
+    lua_setmetatable(L, -2);
+}
+
+static int lut_gc (lua_State *L)
+{
+    check_args(L, 1);
+    ColourLut *self = check_ptr<ColourLut>(L, 1, LUT_TAG);
+    lua_extmemburden(L, -(long)self->numBytes());
+    delete self;
+    return 0;
+}
+
+static int lut_eq (lua_State *L)
+{
+    check_args(L, 2);
+    ColourLut *self = check_ptr<ColourLut>(L, 1, LUT_TAG);
+    ColourLut *that = check_ptr<ColourLut>(L, 2, LUT_TAG);
+    lua_pushboolean(L, self==that);
+    return 1;
+}
+
+static int lut_tostring (lua_State *L)
+{
+    check_args(L,1);
+    ColourLut *self = check_ptr<ColourLut>(L, 1, LUT_TAG);
+    std::stringstream ss;
+    ss << *self;
+    push_string(L, ss.str());
+    return 1;
+}
+
+static int lut_index (lua_State *L)
+{
+    check_args(L,2);
+    ColourLut *self = check_ptr<ColourLut>(L, 1, LUT_TAG);
+    const char *key = luaL_checkstring(L, 2);
+    if (!::strcmp(key, "size")) {
+        lua_pushnumber(L, self->size3d);
+    } else if (!::strcmp(key, "shaperSize")) {
+        lua_pushnumber(L, self->size1d);
+    } else if (!::strcmp(key, "title")) {
+        push_string(L, self->title);
+    } else {
+        my_lua_error(L, "Not a readable ColourLut field: \""+std::string(key)+"\"");
+    }
+    return 1;
+}
+
+const luaL_reg lut_meta_table[] = {
+    {"__tostring", lut_tostring},
+    {"__gc",       lut_gc},
+    {"__index",    lut_index},
+    {"__eq",       lut_eq},
+
+    {NULL, NULL}
+};
+
+static int global_load_lut (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L, 1);
+    std::string filename = luaL_checkstring(L, 1);
+    push_lut(L, new ColourLut(filename));
+    return 1;
+HANDLE_END
+}
+
 static int global_dds_save_simple (lua_State *L)
 {
 HANDLE_BEGIN
@@ -2745,6 +3805,83 @@ HANDLE_BEGIN
 HANDLE_END
 }
 
+// The 6 faces of a cube, as 6 consecutive image arguments in the order dds_save_cube takes them.
+static void check_cube_faces (lua_State *L, int index, ImageBase **faces)
+{
+    for (unsigned f=0 ; f<6 ; ++f) faces[f] = check_ptr<ImageBase>(L, index + f, IMAGE_TAG);
+}
+
+static int global_equirect_to_cube (lua_State *L)
+{
+HANDLE_BEGIN
+    SampleFilter filter = SAMPLE_BILINEAR;
+    switch (lua_gettop(L)) {
+        case 3: filter = sample_filter_from_string(luaL_checkstring(L, 3)); __attribute__((fallthrough));
+        case 2: break;
+        default:
+        my_lua_error(L, "equirect_to_cube takes 2 or 3 arguments");
+    }
+    ImageBase *self = check_ptr<ImageBase>(L, 1, IMAGE_TAG);
+    uimglen_t size = check_int(L, 2, 1, std::numeric_limits<uimglen_t>::max());
+    ImageBase *faces[6];
+    cube_from_equirect(self, size, filter, faces);
+    for (unsigned f=0 ; f<6 ; ++f) push_image(L, faces[f]);
+    return 6;
+HANDLE_END
+}
+
+static int global_cube_to_equirect (lua_State *L)
+{
+HANDLE_BEGIN
+    SampleFilter filter = SAMPLE_BILINEAR;
+    switch (lua_gettop(L)) {
+        case 8: filter = sample_filter_from_string(luaL_checkstring(L, 8)); __attribute__((fallthrough));
+        case 7: break;
+        default:
+        my_lua_error(L, "cube_to_equirect takes 7 or 8 arguments");
+    }
+    ImageBase *faces[6];
+    check_cube_faces(L, 1, faces);
+    uimglen_t width, height;
+    check_coord(L, 7, width, height);
+    push_image(L, cube_to_equirect(faces, width, height, filter));
+    return 1;
+HANDLE_END
+}
+
+static int global_cube_irradiance (lua_State *L)
+{
+HANDLE_BEGIN
+    check_args(L, 7);
+    ImageBase *faces[6];
+    check_cube_faces(L, 1, faces);
+    uimglen_t size = check_int(L, 7, 1, std::numeric_limits<uimglen_t>::max());
+    ImageBase *out[6];
+    cube_irradiance(faces, size, out);
+    for (unsigned f=0 ; f<6 ; ++f) push_image(L, out[f]);
+    return 6;
+HANDLE_END
+}
+
+static int global_cube_specular (lua_State *L)
+{
+HANDLE_BEGIN
+    unsigned samples = 64;
+    switch (lua_gettop(L)) {
+        case 7: samples = check_int(L, 7, 1, 1 << 16); __attribute__((fallthrough));
+        case 6: break;
+        default:
+        my_lua_error(L, "cube_specular takes 6 or 7 arguments");
+    }
+    ImageBase *faces[6];
+    check_cube_faces(L, 1, faces);
+    ImageBases out[6];
+    cube_specular(faces, samples, out);
+    for (unsigned f=0 ; f<6 ; ++f) push_mipmaps(L, out[f]);
+    return 6;
+HANDLE_END
+}
+
 static int global_gif_open (lua_State *L)
 {
 HANDLE_BEGIN
@@ -2923,7 +4060,9 @@ static const luaL_reg global[] = {
     {"make", global_make},
     {"open", global_open},
     {"text_codepoint", global_text_codepoint},
+    {"text_codepoint_sdf", global_text_codepoint_sdf},
     {"text", global_text},
+    {"text_batch", global_text_batch},
     {"dds_save_simple", global_dds_save_simple},
     {"dds_save_cube", global_dds_save_cube},
     {"dds_save_volume", global_dds_save_volume},
@@ -2932,6 +4071,13 @@ static const luaL_reg global[] = {
     {"gif_save", global_gif_save},
     {"mipmaps", global_mipmaps},
     {"volume_mipmaps", global_volume_mipmaps},
+    {"normal_mipmaps", global_normal_mipmaps},
+    {"sampler", global_sampler},
+    {"equirect_to_cube", global_equirect_to_cube},
+    {"cube_to_equirect", global_cube_to_equirect},
+    {"cube_irradiance", global_cube_irradiance},
+    {"cube_specular", global_cube_specular},
+    {"load_lut", global_load_lut},
     {"RGBtoHSL", global_rgb_to_hsl},
     {"HSLtoRGB", global_hsl_to_rgb},
     {"HSVtoHSL", global_hsv_to_hsl},
@@ -2941,6 +4087,9 @@ static const luaL_reg global[] = {
     {"lerp", global_lerp},
     {"colour", global_colour},
     {"gaussian", global_gaussian},
+    {"psnr", global_psnr},
+    {"ssim", global_ssim},
+    {"ms_ssim", global_ms_ssim},
     {"seconds", global_seconds},
  //   {"make_voxel", global_make_voxel},
 
@@ -2956,6 +4105,18 @@ void lua_wrappers_image_init (lua_State *L)
     luaL_register(L, NULL, image_meta_table);
     lua_pop(L,1);
 
+    luaL_newmetatable(L, INTEGRAL_TAG);
+    luaL_register(L, NULL, integral_meta_table);
+    lua_pop(L,1);
+
+    luaL_newmetatable(L, SAMPLER_TAG);
+    luaL_register(L, NULL, sampler_meta_table);
+    lua_pop(L,1);
+
+    luaL_newmetatable(L, LUT_TAG);
+    luaL_register(L, NULL, lut_meta_table);
+    lua_pop(L,1);
+
 /*
     luaL_newmetatable(L, VIMAGE_TAG);
     luaL_register(L, NULL, vimage_meta_table);
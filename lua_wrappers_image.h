@@ -32,6 +32,9 @@ extern "C" {
 
 #define IMAGE_TAG "Image"
 #define VIMAGE_TAG "VoxelImage"
+#define INTEGRAL_TAG "IntegralImage"
+#define SAMPLER_TAG "TextureSampler"
+#define LUT_TAG "ColourLut"
 
 void check_args (lua_State *L, int expected);
 
@@ -28,14 +28,17 @@
 
 
 extern "C" {
-	#include <FreeImage.h>
     #include "lua.h"
     #include "lauxlib.h"
     #include "lualib.h"
 }
 
 
+#include "batch.h"
 #include "interpreter.h"
+#include "parallel.h"
+#include "server.h"
+#include "startup_profile.h"
 #include "image.h"
 #include "text.h"
 
@@ -57,18 +60,19 @@ const char *usage =
     "              | -F <file> | --File <file>       Short-hand for -f <file> --\n"
     "              | -i | --interactive              Enter interactive mode after processing -e and -f\n"
     "              | -p <str> | --prompt <str>       Override the interactive prompt (default \"luaimg> \")\n"
+    "              | --each <glob|listfile>          Run the scripts once per input, input is first of ...\n"
+    "              | -j <n> | --jobs <n>             Worker processes for --each/--serve (default: #cores)\n"
+    "              | --serve <socket>                Run a server on the given Unix domain socket\n"
+    "              | --client <socket>               Send the -e, -f and <arg>s to a server for execution\n"
+    "              | --cache-dir <dir>               Cache compiled scripts in <dir> (or $LUAIMG_CACHE_DIR)\n"
+    "              | --startup-profile               Print the time taken to initialise each subsystem\n"
+    "              | --threads <n>                   Threads used by image operations (default: #cores)\n"
     "Scripts and snippets are executed in sequence.\n"
     "The non-option <arg> list is passed to the code via the Lua ... construct.\n"
+    "With --each, every input gets a fresh interpreter and a summary is written to stderr.\n"
 ;
 
 
-void my_freeimage_error (FREE_IMAGE_FORMAT fif, const char *str)
-{
-    (void) fif;
-    std::cerr << str << std::endl;
-}
-
-
 std::string next_arg(int& so_far, int argc, char **argv)
 {
         if (so_far==argc) {
@@ -79,18 +83,21 @@ std::string next_arg(int& so_far, int argc, char **argv)
         return argv[so_far++];
 }
 
-enum FileOrSnippet { F, S };
-
 int main (int argc, char **argv)
 {
 
     bool interactive = false;
-    typedef std::vector<std::pair<FileOrSnippet,std::string>> Work;
     Work work;
     int so_far = 1; 
     bool no_more_switches = false;
     std::vector<std::string> args;
     std::string prompt = "luaimg> ";
+    std::string each;
+    std::string serve;
+    std::string client;
+    std::string cache_dir;
+    bool startup_profile = false;
+    unsigned jobs = 0;
     while (so_far < argc) {
         std::string arg = next_arg(so_far, argc, argv);
         if (no_more_switches) {
@@ -105,6 +112,31 @@ int main (int argc, char **argv)
             interactive = true;
         } else if (arg=="-p" || arg=="--prompt") {
             prompt = next_arg(so_far,argc,argv);
+        } else if (arg=="--each") {
+            each = next_arg(so_far,argc,argv);
+        } else if (arg=="--serve") {
+            serve = next_arg(so_far,argc,argv);
+        } else if (arg=="--client") {
+            client = next_arg(so_far,argc,argv);
+        } else if (arg=="--startup-profile") {
+            startup_profile = true;
+        } else if (arg=="--threads") {
+            std::string n = next_arg(so_far,argc,argv);
+            unsigned threads = strtoul(n.c_str(), NULL, 10);
+            if (threads < 1) {
+                std::cerr<<"ERROR: Invalid number of threads: \""<<n<<"\""<<std::endl;
+                exit(EXIT_FAILURE);
+            }
+            parallel_set_threads(threads);
+        } else if (arg=="--cache-dir") {
+            cache_dir = next_arg(so_far,argc,argv);
+        } else if (arg=="-j" || arg=="--jobs") {
+            std::string n = next_arg(so_far,argc,argv);
+            jobs = strtoul(n.c_str(), NULL, 10);
+            if (jobs < 1) {
+                std::cerr<<"ERROR: Invalid number of jobs: \""<<n<<"\""<<std::endl;
+                exit(EXIT_FAILURE);
+            }
         } else if (arg=="-f" || arg=="--file") {
             work.push_back(std::pair<FileOrSnippet,std::string>(F, next_arg(so_far,argc,argv)));
         } else if (arg=="-F" || arg=="--File") {
@@ -117,7 +149,32 @@ int main (int argc, char **argv)
         }
     }
 
-    if (work.size()==0 && !interactive) {
+    if (each != "") {
+        if (work.size()==0) {
+            std::cerr<<"ERROR: --each requires -e, -f or -F to say what to do with each input."<<std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (interactive) {
+            std::cerr<<"ERROR: --each cannot be combined with interactive mode."<<std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (serve != "" && (work.size()>0 || interactive || each != "" || client != "")) {
+        std::cerr<<"ERROR: --serve takes its work from clients, and cannot be combined with -e, -f, -i, --each or --client."<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (client != "") {
+        if (work.size()==0 || interactive || each != "") {
+            std::cerr<<"ERROR: --client requires -e, -f or -F, and cannot be combined with -i or --each."<<std::endl;
+            exit(EXIT_FAILURE);
+        }
+        // The server does all the work, so there is nothing to initialise here.
+        return client_run(client, work, args);
+    }
+
+    if (work.size()==0 && !interactive && serve == "") {
         std::cerr<<info;
 
         std::cerr<<
@@ -130,32 +187,40 @@ int main (int argc, char **argv)
     }
 
 
-    FreeImage_Initialise();
-    FreeImage_SetOutputMessage(my_freeimage_error);
+    if (startup_profile) startup_profile_enable();
 
-    text_init();
+    if (cache_dir == "") {
+        const char *env = getenv("LUAIMG_CACHE_DIR");
+        if (env != NULL) cache_dir = env;
+    }
+    interpreter_set_cache_dir(cache_dir);
+
+    // FreeImage and FreeType are initialised the first time they are used, except when forking
+    // workers, where doing it once up front saves every worker from doing it.
+
+    if (serve != "") {
+        image_init();
+        text_init();
+        int status = server_run(serve, jobs == 0 ? batch_default_jobs() : jobs);
+        text_shutdown();
+        image_shutdown();
+        return status;
+    }
+
+    if (each != "") {
+        image_init();
+        text_init();
+        std::vector<std::string> inputs = batch_inputs(each);
+        unsigned long failures = batch_run(work, inputs, args, jobs == 0 ? batch_default_jobs() : jobs);
+        text_shutdown();
+        image_shutdown();
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
     interpreter_init();
 
-    unsigned snippet_counter = 0;
-    for (Work::iterator i=work.begin(),i_=work.end() ; i!=i_ ; ++i) {
-        switch (i->first) {
-            case F:
-            if (!interpreter_exec_file(i->second, args)) {
-                return EXIT_FAILURE;
-            }
-            break;
-
-            case S: {
-                snippet_counter++;
-                std::stringstream ss;
-                ss << "[snippet" << snippet_counter << "]";
-                if (!interpreter_exec_snippet(i->second, args, ss.str())) {
-                    return EXIT_FAILURE;
-                }
-            }
-            break;
-        }
+    if (!interpreter_exec_work(work, args)) {
+        return EXIT_FAILURE;
     }
 
     if (interactive) {
@@ -164,8 +229,8 @@ int main (int argc, char **argv)
 
     interpreter_shutdown();
 
-    FreeImage_DeInitialise();
+    text_shutdown();
+    image_shutdown();
 
     return EXIT_SUCCESS;
 }
-
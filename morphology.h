@@ -0,0 +1,42 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include "image.h"
+
+/** Grey-level erosion: each channel of each pixel becomes the minimum of that
+ * channel over the (2*rx+1) by (2*ry+1) rectangle centred on it.  Pixels
+ * beyond the edges of the image are ignored.  Uses the van Herk / Gil-Werman
+ * algorithm, so the cost does not depend on the radius. */
+ImageBase *morph_erode (const ImageBase *src, uimglen_t rx, uimglen_t ry);
+
+/** Grey-level dilation, as morph_erode but with the maximum. */
+ImageBase *morph_dilate (const ImageBase *src, uimglen_t rx, uimglen_t ry);
+
+/** Erosion followed by dilation (removes small bright features). */
+ImageBase *morph_open (const ImageBase *src, uimglen_t rx, uimglen_t ry);
+
+/** Dilation followed by erosion (fills small dark gaps). */
+ImageBase *morph_close (const ImageBase *src, uimglen_t rx, uimglen_t ry);
+
+#endif
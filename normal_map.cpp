@@ -0,0 +1,140 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include <exception.h>
+
+#include "normal_map.h"
+#include "parallel.h"
+
+namespace {
+
+    size_t edge (ptrdiff_t i, size_t len, bool wrap)
+    {
+        if (wrap) return (i + ptrdiff_t(len)) % ptrdiff_t(len);
+        return i < 0 ? 0 : size_t(i) >= len ? len - 1 : size_t(i);
+    }
+
+    void store (float nx, float ny, float nz, float *out, bool xy_only)
+    {
+        float inv = 1 / std::sqrt(nx*nx + ny*ny + nz*nz);
+        out[0] = 0.5f + 0.5f * nx * inv;
+        out[1] = 0.5f + 0.5f * ny * inv;
+        if (!xy_only) out[2] = 0.5f + 0.5f * nz * inv;
+    }
+
+    // Unpack an encoded normal, reconstructing z when only x and y are stored.
+    void load (const float *in, chan_t n, float *v)
+    {
+        v[0] = in[0] * 2 - 1;
+        v[1] = in[1] * 2 - 1;
+        v[2] = n >= 3 ? in[2] * 2 - 1 : std::sqrt(std::max(0.0f, 1 - v[0]*v[0] - v[1]*v[1]));
+    }
+
+}
+
+ImageBase *height_to_normal (const ImageBase *src, float strength, NormalFilter filter,
+                             bool wrap_x, bool wrap_y, bool xy_only)
+{
+    // Derivative along one axis, smoothed across it with weights (side, centre, side); each is
+    // normalised so a slope of 1 per pixel gives 1.
+    float side, centre;
+    switch (filter) {
+        case NORMAL_CENTRAL: side = 0; centre = 1; break;
+        case NORMAL_SOBEL: side = 1; centre = 2; break;
+        case NORMAL_SCHARR: default: side = 3; centre = 10; break;
+    }
+    float scale = strength / (2 * (2*side + centre));
+    side *= scale;
+    centre *= scale;
+
+    uimglen_t w = src->width, h = src->height;
+    chan_t n = src->channels();
+    chan_t out_n = xy_only ? 2 : 3;
+    ImageBase *dst = image_alloc(w, h, out_n, false);
+    if (w == 0 || h == 0) return dst;
+    const float *in = src->raw();
+    float *out = dst->raw();
+
+    parallel_for(h, size_t(w) * 16, [&] (size_t begin, size_t end) {
+        // Heights of the 3 rows around y, padded by one column each side so the stencil loop
+        // below has no edge cases.
+        std::vector<float> rows[3];
+        for (int r=0 ; r<3 ; ++r) rows[r].resize(w + 2);
+        for (size_t y=begin ; y<end ; ++y) {
+            for (int r=0 ; r<3 ; ++r) {
+                const float *line = &in[edge(ptrdiff_t(y) + r - 1, h, wrap_y) * w * n];
+                float *row = &rows[r][1];
+                for (size_t x=0 ; x<w ; ++x) row[x] = line[x * n];
+                row[-1] = line[edge(-1, w, wrap_x) * n];
+                row[w] = line[edge(w, w, wrap_x) * n];
+            }
+            const float *b = &rows[0][1], *c = &rows[1][1], *t = &rows[2][1];
+            float *o = &out[size_t(y) * w * out_n];
+            for (size_t x=0 ; x<w ; ++x) {
+                float dx = side * (b[x+1] - b[x-1] + t[x+1] - t[x-1]) + centre * (c[x+1] - c[x-1]);
+                float dy = side * (t[x-1] - b[x-1] + t[x+1] - b[x+1]) + centre * (t[x] - b[x]);
+                store(-dx, -dy, 1, &o[x * out_n], xy_only);
+            }
+        }
+    });
+    return dst;
+}
+
+ImageBase *normal_halve (const ImageBase *src)
+{
+    chan_t n = src->channels();
+    if (n != 2 && n != 3) EXCEPTEX << "Normal maps must have 2 or 3 channels, got " << int(n) << ENDL;
+    if (src->hasAlpha()) EXCEPTEX << "Normal maps must not have an alpha channel." << ENDL;
+    uimglen_t sw = src->width, sh = src->height;
+    uimglen_t w = std::max<uimglen_t>(1, sw / 2), h = std::max<uimglen_t>(1, sh / 2);
+    ImageBase *dst = image_alloc(w, h, n, false);
+    if (sw == 0 || sh == 0) return dst;
+    const float *in = src->raw();
+    float *out = dst->raw();
+    parallel_for(h, size_t(w) * 32, [&] (size_t begin, size_t end) {
+        for (size_t y=begin ; y<end ; ++y) {
+            size_t ys[2] = { std::min<size_t>(2*y, sh - 1), std::min<size_t>(2*y + 1, sh - 1) };
+            for (size_t x=0 ; x<w ; ++x) {
+                size_t xs[2] = { std::min<size_t>(2*x, sw - 1), std::min<size_t>(2*x + 1, sw - 1) };
+                float sum[3] = {0, 0, 0};
+                for (int j=0 ; j<2 ; ++j) {
+                    for (int i=0 ; i<2 ; ++i) {
+                        float v[3];
+                        load(&in[(ys[j]*sw + xs[i]) * n], n, v);
+                        for (int k=0 ; k<3 ; ++k) sum[k] += v[k];
+                    }
+                }
+                // Opposing normals can cancel out, fall back to straight up.
+                if (sum[0]*sum[0] + sum[1]*sum[1] + sum[2]*sum[2] < 1e-12f) {
+                    sum[0] = sum[1] = 0;
+                    sum[2] = 1;
+                }
+                store(sum[0], sum[1], sum[2], &out[(y*w + x) * n], n == 2);
+            }
+        }
+    });
+    return dst;
+}
@@ -0,0 +1,46 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef NORMAL_MAP_H
+#define NORMAL_MAP_H
+
+#include "image.h"
+
+enum NormalFilter {
+    NORMAL_CENTRAL,
+    NORMAL_SOBEL,
+    NORMAL_SCHARR
+};
+
+/** Tangent-space normal map of the height field in the first channel of src.  The slope is
+ * estimated with a 3x3 kernel (central differences, or Sobel or Scharr which also smooth across
+ * the slope), scaled by strength, and the normal (-dh/dx, -dh/dy, 1) normalised and stored as
+ * 0.5 + 0.5*n.  The result is Image<3,0>, or Image<2,0> with only x and y (for BC5, the shader
+ * reconstructing z).  Beyond the edges the height wraps around or the edge pixels are repeated,
+ * as in convolve. */
+ImageBase *height_to_normal (const ImageBase *src, float strength, NormalFilter filter,
+                             bool wrap_x, bool wrap_y, bool xy_only);
+
+/** Next mip of a normal map encoded as by height_to_normal (2 or 3 channels): each 2x2 block is
+ * averaged as vectors and the result renormalised, so the normals stay unit length. */
+ImageBase *normal_halve (const ImageBase *src);
+
+#endif
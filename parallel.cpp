@@ -0,0 +1,105 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+// Below this much work (roughly, in pixel operations) threads are not worth starting.
+static const size_t MIN_PARALLEL_COST = 64 * 1024;
+
+// Items per block in parallel_sum, must not depend on the number of threads.
+static const size_t SUM_BLOCK = 4096;
+
+static unsigned threads_override = 0;
+
+unsigned parallel_threads (void)
+{
+    if (threads_override > 0) return threads_override;
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+void parallel_set_threads (unsigned n)
+{
+    threads_override = n;
+}
+
+void parallel_for (size_t n, size_t cost, const std::function<void(size_t, size_t)> &f)
+{
+    if (n == 0) return;
+    size_t threads = parallel_threads();
+    if (threads > n) threads = n;
+    if (threads <= 1 || n * cost < MIN_PARALLEL_COST) {
+        f(0, n);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    auto chunk = [&] (size_t t) {
+        try {
+            f(n * t / threads, n * (t + 1) / threads);
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+    for (size_t t=1 ; t<threads ; ++t) {
+        workers.push_back(std::thread(chunk, t));
+    }
+    chunk(0);
+    for (size_t t=0 ; t<workers.size() ; ++t) {
+        workers[t].join();
+    }
+    for (size_t t=0 ; t<threads ; ++t) {
+        if (errors[t]) std::rethrow_exception(errors[t]);
+    }
+}
+
+void parallel_sum (size_t n, unsigned width, size_t cost,
+                   const std::function<void(size_t, size_t, double *)> &f, double *out)
+{
+    size_t blocks = (n + SUM_BLOCK - 1) / SUM_BLOCK;
+    std::vector<double> partial(blocks * width, 0.0);
+    parallel_for(blocks, SUM_BLOCK * cost, [&] (size_t begin, size_t end) {
+        for (size_t b=begin ; b<end ; ++b)
+            f(b * SUM_BLOCK, std::min(n, (b + 1) * SUM_BLOCK), &partial[b * width]);
+    });
+
+    // Pairwise, so rounding error grows with log(blocks) rather than blocks.
+    while (blocks > 1) {
+        size_t half = blocks / 2;
+        for (size_t b=0 ; b<half ; ++b) {
+            for (unsigned c=0 ; c<width ; ++c)
+                partial[b * width + c] = partial[2*b * width + c] + partial[(2*b + 1) * width + c];
+        }
+        if (blocks % 2 == 1) {
+            for (unsigned c=0 ; c<width ; ++c)
+                partial[half * width + c] = partial[(blocks - 1) * width + c];
+        }
+        blocks = half + blocks % 2;
+    }
+    for (unsigned c=0 ; c<width ; ++c) out[c] = blocks == 0 ? 0 : partial[c];
+}
@@ -0,0 +1,51 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstdlib>
+
+#include <functional>
+
+/** The number of threads used by parallel_for (by default, the number of cores). */
+unsigned parallel_threads (void);
+
+/** Override the number of threads, 0 restores the default. */
+void parallel_set_threads (unsigned n);
+
+/** Call f(begin, end) for contiguous chunks covering [0,n), concurrently.  The
+ * cost is a rough estimate of the work per item (e.g. pixels in a row), if the
+ * total is small then f(0,n) is simply called on this thread.  f must not touch
+ * the Lua state.  If f throws, the exception is rethrown here once all chunks
+ * have finished. */
+void parallel_for (size_t n, size_t cost, const std::function<void(size_t, size_t)> &f);
+
+/** Deterministic parallel sum.  [0,n) is split into blocks of a fixed size,
+ * f(begin, end, acc) adds the contributions of items begin to end into acc
+ * (width doubles, initially 0), and the block totals are then added pairwise in
+ * a fixed order.  So the result is the same whatever the number of threads, and
+ * does not lose precision on large images the way a single float accumulator
+ * does.  The totals are written to out (width doubles). */
+void parallel_sum (size_t n, unsigned width, size_t cost,
+                   const std::function<void(size_t, size_t, double *)> &f, double *out);
+
+#endif
@@ -0,0 +1,243 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <exception.h>
+
+#include "parallel.h"
+#include "quality.h"
+
+namespace {
+
+    const int WINDOW = 11;
+    const double SIGMA = 1.5;
+    const double C1 = 0.01 * 0.01;
+    const double C2 = 0.03 * 0.03;
+    const double MS_SSIM_WEIGHTS[] = { 0.0448, 0.2856, 0.3001, 0.2363, 0.1333 };
+    const unsigned MS_SSIM_SCALES = sizeof(MS_SSIM_WEIGHTS) / sizeof(*MS_SSIM_WEIGHTS);
+
+    // One channel of an image, stored contiguously.
+    struct Plane {
+        uimglen_t width, height;
+        std::vector<float> data;
+        Plane (uimglen_t width, uimglen_t height)
+          : width(width), height(height), data(size_t(width) * height)
+        { }
+        float &at (size_t x, size_t y) { return data[y * width + x]; }
+        float at (size_t x, size_t y) const { return data[y * width + x]; }
+    };
+
+    Plane extract (const ImageBase *img, chan_t c)
+    {
+        Plane p(img->width, img->height);
+        const float *in = img->raw();
+        chan_t channels = img->channels();
+        for (size_t i=0 ; i<p.data.size() ; ++i) p.data[i] = in[i * channels + c];
+        return p;
+    }
+
+    // 2x2 box downsample, dropping an odd last row or column.
+    Plane downsample (const Plane &p)
+    {
+        Plane r(p.width / 2, p.height / 2);
+        for (size_t y=0 ; y<r.height ; ++y) {
+            for (size_t x=0 ; x<r.width ; ++x) {
+                r.at(x, y) = 0.25f * (p.at(2*x, 2*y) + p.at(2*x+1, 2*y)
+                                      + p.at(2*x, 2*y+1) + p.at(2*x+1, 2*y+1));
+            }
+        }
+        return r;
+    }
+
+    std::vector<float> gaussian_window (void)
+    {
+        std::vector<float> w(WINDOW);
+        double total = 0;
+        for (int i=0 ; i<WINDOW ; ++i) {
+            double d = i - WINDOW / 2;
+            w[i] = std::exp(-d * d / (2 * SIGMA * SIGMA));
+            total += w[i];
+        }
+        for (int i=0 ; i<WINDOW ; ++i) w[i] /= total;
+        return w;
+    }
+
+    // Mean SSIM and mean contrast-structure term over all window positions that fit.  The five
+    // local statistics are filtered separably: rows first (the products are formed on the fly),
+    // then columns.  Each pass runs over rows in parallel, with inner loops along contiguous
+    // memory so they vectorise.
+    void ssim_plane (const Plane &a, const Plane &b, double &ssim, double &cs)
+    {
+        static const std::vector<float> w = gaussian_window();
+        size_t ow = a.width - (WINDOW - 1);
+        size_t oh = a.height - (WINDOW - 1);
+        size_t width = a.width;
+
+        // Horizontally filtered mu_a, mu_b, a^2, b^2, ab, each ow by a.height.
+        std::vector<float> h[5];
+        for (auto &v : h) v.resize(ow * a.height);
+        parallel_for(a.height, ow * WINDOW * 5, [&] (size_t begin, size_t end) {
+            for (size_t y=begin ; y<end ; ++y) {
+                const float *ra = &a.data[y * width];
+                const float *rb = &b.data[y * width];
+                float *h0 = &h[0][y * ow], *h1 = &h[1][y * ow], *h2 = &h[2][y * ow];
+                float *h3 = &h[3][y * ow], *h4 = &h[4][y * ow];
+                for (size_t x=0 ; x<ow ; ++x) {
+                    float s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0;
+                    for (int k=0 ; k<WINDOW ; ++k) {
+                        float va = ra[x + k], vb = rb[x + k], wk = w[k];
+                        s0 += wk * va;
+                        s1 += wk * vb;
+                        s2 += wk * va * va;
+                        s3 += wk * vb * vb;
+                        s4 += wk * va * vb;
+                    }
+                    h0[x] = s0; h1[x] = s1; h2[x] = s2; h3[x] = s3; h4[x] = s4;
+                }
+            }
+        });
+
+        // Per-row sums, added up afterwards in order so the result does not depend on threads.
+        std::vector<double> row_ssim(oh), row_cs(oh);
+        parallel_for(oh, ow * WINDOW * 5, [&] (size_t begin, size_t end) {
+            std::vector<float> v[5];
+            for (auto &row : v) row.resize(ow);
+            for (size_t y=begin ; y<end ; ++y) {
+                for (int i=0 ; i<5 ; ++i) {
+                    float *out = &v[i][0];
+                    std::fill(out, out + ow, 0.0f);
+                    for (int k=0 ; k<WINDOW ; ++k) {
+                        const float *in = &h[i][(y + k) * ow];
+                        float wk = w[k];
+                        for (size_t x=0 ; x<ow ; ++x) out[x] += wk * in[x];
+                    }
+                }
+                double sum_ssim = 0, sum_cs = 0;
+                for (size_t x=0 ; x<ow ; ++x) {
+                    double mu_a = v[0][x], mu_b = v[1][x];
+                    double var_a = v[2][x] - mu_a * mu_a;
+                    double var_b = v[3][x] - mu_b * mu_b;
+                    double cov = v[4][x] - mu_a * mu_b;
+                    double l = (2 * mu_a * mu_b + C1) / (mu_a * mu_a + mu_b * mu_b + C1);
+                    double c = (2 * cov + C2) / (var_a + var_b + C2);
+                    sum_ssim += l * c;
+                    sum_cs += c;
+                }
+                row_ssim[y] = sum_ssim;
+                row_cs[y] = sum_cs;
+            }
+        });
+        double totals[2] = { 0, 0 };
+        for (size_t y=0 ; y<oh ; ++y) {
+            totals[0] += row_ssim[y];
+            totals[1] += row_cs[y];
+        }
+        double n = double(ow) * oh;
+        ssim = totals[0] / n;
+        cs = totals[1] / n;
+    }
+
+    void check_compatible (const ImageBase *a, const ImageBase *b)
+    {
+        if (a->width != b->width || a->height != b->height
+            || a->channels() != b->channels() || a->hasAlpha() != b->hasAlpha()) {
+            EXCEPT << "Images must have the same size and channels: " << a << " and " << b << ENDL;
+        }
+    }
+
+    void check_window_fits (const ImageBase *a)
+    {
+        if (a->width < uimglen_t(WINDOW) || a->height < uimglen_t(WINDOW)) {
+            EXCEPT << "Image must be at least " << WINDOW << "x" << WINDOW << " for SSIM: " << a
+                   << ENDL;
+        }
+    }
+
+}
+
+double quality_psnr (const ImageBase *a, const ImageBase *b, float peak)
+{
+    check_compatible(a, b);
+    size_t samples = a->numPixels() * a->channels();
+    if (samples == 0) EXCEPT << "Cannot compute PSNR of an empty image." << ENDL;
+    const float *ra = a->raw(), *rb = b->raw();
+    double sse;
+    parallel_sum(samples, 1, 1, [&] (size_t begin, size_t end, double *acc) {
+        for (size_t i=begin ; i<end ; ++i) {
+            double d = ra[i] - rb[i];
+            acc[0] += d * d;
+        }
+    }, &sse);
+    if (sse == 0) return std::numeric_limits<double>::infinity();
+    return 10 * std::log10(double(peak) * peak / (sse / samples));
+}
+
+double quality_ssim (const ImageBase *a, const ImageBase *b)
+{
+    check_compatible(a, b);
+    check_window_fits(a);
+    double total = 0;
+    for (chan_t c=0 ; c<a->channels() ; ++c) {
+        double ssim, cs;
+        ssim_plane(extract(a, c), extract(b, c), ssim, cs);
+        total += ssim;
+    }
+    return total / a->channels();
+}
+
+double quality_ms_ssim (const ImageBase *a, const ImageBase *b)
+{
+    check_compatible(a, b);
+    check_window_fits(a);
+
+    unsigned scales = 1;
+    for (uimglen_t w=a->width/2, h=a->height/2 ; scales < MS_SSIM_SCALES ; w/=2, h/=2) {
+        if (w < uimglen_t(WINDOW) || h < uimglen_t(WINDOW)) break;
+        scales++;
+    }
+    double weight_total = 0;
+    for (unsigned s=0 ; s<scales ; ++s) weight_total += MS_SSIM_WEIGHTS[s];
+
+    double total = 0;
+    for (chan_t c=0 ; c<a->channels() ; ++c) {
+        Plane pa = extract(a, c), pb = extract(b, c);
+        double result = 1;
+        for (unsigned s=0 ; s<scales ; ++s) {
+            double ssim, cs;
+            ssim_plane(pa, pb, ssim, cs);
+            double weight = MS_SSIM_WEIGHTS[s] / weight_total;
+            // Negative terms (anti-correlated structure) would make fractional powers undefined.
+            double term = s + 1 < scales ? cs : ssim;
+            result *= std::pow(term < 0 ? 0 : term, weight);
+            if (s + 1 < scales) {
+                pa = downsample(pa);
+                pb = downsample(pb);
+            }
+        }
+        total += result;
+    }
+    return total / a->channels();
+}
@@ -0,0 +1,44 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include "image.h"
+
+/** Peak signal to noise ratio in dB over all channels, for values whose full
+ * range is [0, peak].  Infinite if the images are identical.  The images must
+ * have the same size and channels. */
+double quality_psnr (const ImageBase *a, const ImageBase *b, float peak);
+
+/** Structural similarity (Wang et al. 2004) with the usual 11x11 Gaussian
+ * window (sigma 1.5), K1 = 0.01, K2 = 0.03 and a dynamic range of 1, averaged
+ * over the window positions that fit inside the image and then over channels.
+ * The images must be the same size and at least 11x11. */
+double quality_ssim (const ImageBase *a, const ImageBase *b);
+
+/** Multi-scale SSIM (Wang et al. 2003): contrast and structure terms at 5
+ * scales, halving the resolution each time, with luminance at the coarsest.
+ * Images too small for 5 scales use as many as fit, with the weights of those
+ * scales renormalised. */
+double quality_ms_ssim (const ImageBase *a, const ImageBase *b);
+
+#endif
@@ -0,0 +1,195 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "parallel.h"
+#include "rank_filter.h"
+
+namespace {
+
+    const unsigned LEVELS = 256;
+    const unsigned COARSE = 16;
+    const unsigned FINE = LEVELS / COARSE;
+
+    // Columns handled by each task of the histogram path.  Each task pays for setting up the
+    // histograms of 2r extra columns, so this should be wide compared to typical radii.
+    const size_t STRIPE_WIDTH = 128;
+
+    inline size_t clamp_index (ptrdiff_t i, size_t n)
+    {
+        return i < 0 ? 0 : size_t(i) >= n ? n - 1 : size_t(i);
+    }
+
+    // Whether v is exactly one of the values the loaders produce from 8 bit data.
+    inline bool to_level (float v, unsigned &level)
+    {
+        if (!(v >= 0 && v <= 1)) return false;
+        level = unsigned(v * 255 + 0.5f);
+        return level / 255.0f == v;
+    }
+
+    // Select the k'th smallest value of each window directly.
+    void rank_direct (const float *in, float *out, uimglen_t width, uimglen_t height,
+                      chan_t channels, size_t rx, size_t ry, size_t k)
+    {
+        parallel_for(height, size_t(width) * channels * (2*rx + 1) * (2*ry + 1),
+                     [&] (size_t begin, size_t end) {
+            std::vector<float> window((2*rx + 1) * (2*ry + 1));
+            for (size_t y=begin ; y<end ; ++y) {
+                for (size_t x=0 ; x<width ; ++x) {
+                    for (chan_t c=0 ; c<channels ; ++c) {
+                        size_t n = 0;
+                        for (ptrdiff_t dy=-ptrdiff_t(ry) ; dy<=ptrdiff_t(ry) ; ++dy) {
+                            const float *row = &in[clamp_index(y + dy, height) * width * channels];
+                            for (ptrdiff_t dx=-ptrdiff_t(rx) ; dx<=ptrdiff_t(rx) ; ++dx)
+                                window[n++] = row[clamp_index(x + dx, width) * channels + c];
+                        }
+                        std::nth_element(window.begin(), window.begin() + k, window.end());
+                        out[(y * width + x) * channels + c] = window[k];
+                    }
+                }
+            }
+        });
+    }
+
+    // Perreault & Hebert, "Median Filtering in Constant Time".  Each column keeps a histogram of
+    // the 2ry+1 values above and below the current row, and the window histogram slides along
+    // the row by adding one column histogram and removing another, so the cost per pixel does
+    // not depend on the radius.  Histograms are two-level: the window's coarse histogram (16
+    // groups of 16 levels) is updated at every pixel, but each group of its fine histogram is
+    // only brought up to date when the rank falls in that group.  Parallel over stripes of
+    // columns, each with its own column histograms.
+    void rank_histogram (const std::vector<uint8_t> &levels, float *out, uimglen_t width,
+                         uimglen_t height, chan_t channels, size_t rx, size_t ry, size_t k)
+    {
+        size_t stripes = (width + STRIPE_WIDTH - 1) / STRIPE_WIDTH;
+        size_t span = 2*rx + 1;
+        parallel_for(stripes, size_t(height) * STRIPE_WIDTH * channels * COARSE,
+                     [&] (size_t begin, size_t end) {
+            for (size_t stripe=begin ; stripe<end ; ++stripe) {
+                size_t x0 = stripe * STRIPE_WIDTH;
+                size_t x1 = std::min<size_t>(x0 + STRIPE_WIDTH, width);
+                // Histograms for the padded columns x0-rx .. x1+rx-1, so the window centred on x
+                // covers columns x-x0 .. x-x0+2rx.
+                size_t columns = x1 - x0 + 2*rx;
+                std::vector<uint32_t> col(columns * LEVELS), col_coarse(columns * COARSE);
+                std::vector<uint32_t> win(LEVELS), win_coarse(COARSE);
+                // The x at which each group of win was last brought up to date.
+                std::vector<size_t> valid_at(COARSE);
+                auto level_at = [&] (ptrdiff_t px, ptrdiff_t y, chan_t c) -> unsigned {
+                    size_t i = clamp_index(y, height) * width + clamp_index(px, width);
+                    return levels[i * channels + c];
+                };
+                auto col_add = [&] (size_t i, unsigned l, uint32_t d) {
+                    col[i * LEVELS + l] += d;
+                    col_coarse[i * COARSE + l / FINE] += d;
+                };
+                for (chan_t c=0 ; c<channels ; ++c) {
+                    std::fill(col.begin(), col.end(), 0);
+                    std::fill(col_coarse.begin(), col_coarse.end(), 0);
+                    for (size_t i=0 ; i<columns ; ++i) {
+                        ptrdiff_t px = ptrdiff_t(x0 + i) - ptrdiff_t(rx);
+                        for (ptrdiff_t dy=-ptrdiff_t(ry) ; dy<=ptrdiff_t(ry) ; ++dy)
+                            col_add(i, level_at(px, dy, c), 1);
+                    }
+                    for (size_t y=0 ; y<height ; ++y) {
+                        std::fill(win_coarse.begin(), win_coarse.end(), 0);
+                        for (size_t i=0 ; i<span ; ++i)
+                            for (unsigned g=0 ; g<COARSE ; ++g) win_coarse[g] += col_coarse[i * COARSE + g];
+                        std::fill(valid_at.begin(), valid_at.end(), size_t(-1));
+                        for (size_t x=x0 ; x<x1 ; ++x) {
+                            size_t seen = 0;
+                            unsigned g = 0;
+                            while (seen + win_coarse[g] <= k) seen += win_coarse[g++];
+
+                            uint32_t *fine = &win[g * FINE];
+                            size_t from = valid_at[g];
+                            if (from == size_t(-1) || x - from >= span) {
+                                std::fill(fine, fine + FINE, 0);
+                                for (size_t i=x-x0 ; i<x-x0+span ; ++i)
+                                    for (unsigned m=0 ; m<FINE ; ++m) fine[m] += col[i * LEVELS + g * FINE + m];
+                            } else {
+                                for (size_t s=from+1 ; s<=x ; ++s) {
+                                    const uint32_t *add = &col[(s - x0 + 2*rx) * LEVELS + g * FINE];
+                                    const uint32_t *sub = &col[(s - x0 - 1) * LEVELS + g * FINE];
+                                    for (unsigned m=0 ; m<FINE ; ++m) fine[m] += add[m] - sub[m];
+                                }
+                            }
+                            valid_at[g] = x;
+
+                            unsigned l = 0;
+                            while (seen + fine[l] <= k) seen += fine[l++];
+                            out[(y * width + x) * channels + c] = (g * FINE + l) / 255.0f;
+
+                            if (x + 1 == x1) break;
+                            const uint32_t *add = &col_coarse[(x - x0 + span) * COARSE];
+                            const uint32_t *sub = &col_coarse[(x - x0) * COARSE];
+                            for (unsigned m=0 ; m<COARSE ; ++m) win_coarse[m] += add[m] - sub[m];
+                        }
+                        if (y + 1 == height) break;
+                        // Slide the column histograms up a row.
+                        for (size_t i=0 ; i<columns ; ++i) {
+                            ptrdiff_t px = ptrdiff_t(x0 + i) - ptrdiff_t(rx);
+                            col_add(i, level_at(px, ptrdiff_t(y) - ptrdiff_t(ry), c), uint32_t(-1));
+                            col_add(i, level_at(px, ptrdiff_t(y) + ptrdiff_t(ry) + 1, c), 1);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+}
+
+ImageBase *rank_filter (const ImageBase *src, uimglen_t rx, uimglen_t ry, float percentile)
+{
+    uimglen_t width = src->width;
+    uimglen_t height = src->height;
+    chan_t channels = src->channels();
+    size_t samples = src->numPixels() * channels;
+    ImageBase *r = src->clone(false, false);
+    if (samples == 0) return r;
+
+    size_t window = (2*size_t(rx) + 1) * (2*size_t(ry) + 1);
+    size_t k = size_t(std::min(std::max(percentile, 0.0f), 100.0f) / 100.0 * (window - 1) + 0.5);
+
+    const float *in = src->raw();
+    std::vector<uint8_t> levels(samples);
+    bool quantised = true;
+    for (size_t i=0 ; i<samples ; ++i) {
+        unsigned level;
+        if (!to_level(in[i], level)) {
+            quantised = false;
+            break;
+        }
+        levels[i] = level;
+    }
+
+    // For tiny windows, selecting directly is cheaper than maintaining histograms.
+    if (quantised && window > 9) {
+        rank_histogram(levels, r->raw(), width, height, channels, rx, ry, k);
+    } else {
+        rank_direct(in, r->raw(), width, height, channels, rx, ry, k);
+    }
+    return r;
+}
@@ -0,0 +1,36 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef RANK_FILTER_H
+#define RANK_FILTER_H
+
+#include "image.h"
+
+/** Each channel of each pixel becomes the given percentile (0 to 100) of that
+ * channel over the (2*rx+1) by (2*ry+1) box centred on it, so 50 is a median
+ * filter, 0 is erosion and 100 is dilation.  Beyond the edges, the edge pixels
+ * are repeated.  The result is always exact.  If every value is an 8 bit level
+ * (as when loaded from most image files), a Perreault-Hebert sliding histogram
+ * is used whose cost per pixel does not depend on the radius; otherwise each
+ * window is selected from directly, which is only fast for small radii. */
+ImageBase *rank_filter (const ImageBase *src, uimglen_t rx, uimglen_t ry, float percentile);
+
+#endif
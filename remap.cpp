@@ -0,0 +1,82 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <exception.h>
+
+#include "parallel.h"
+#include "remap.h"
+
+namespace {
+
+    // The filter is a template parameter so the sampler's switch folds away and the per-channel
+    // loops in each filter unroll for the channel count.
+    template<chan_t n, SampleFilter f> void remap_rows (const Sampler2D<n> &s, const float *coords,
+                                                        float *out, uimglen_t w, uimglen_t h)
+    {
+        size_t cost = size_t(w) * (f == SAMPLE_CATMULLROM ? 16 : f == SAMPLE_BILINEAR ? 4 : 1);
+        parallel_for(h, cost, [&] (size_t begin, size_t end) {
+            for (size_t i=begin*w ; i<end*w ; ++i) {
+                s.sample(f, coords[2*i] + 0.5f, coords[2*i + 1] + 0.5f, &out[i*n]);
+            }
+        });
+    }
+
+    template<chan_t n> void remap_n (const ImageBase *src, const ImageBase *coords, ImageBase *dst,
+                                     SampleFilter filter, bool wrap_x, bool wrap_y)
+    {
+        const float bg[4] = {0, 0, 0, 0};
+        Sampler2D<n> s(src->raw(), src->width, src->height,
+                       wrap_x ? SAMPLE_WRAP : SAMPLE_CLAMP, wrap_y ? SAMPLE_WRAP : SAMPLE_CLAMP, bg);
+        if (src->width == 0 || src->height == 0) s.borderX = s.borderY = SAMPLE_COLOUR;
+        const float *c = coords->raw();
+        float *out = dst->raw();
+        switch (filter) {
+            case SAMPLE_NEAREST:
+            remap_rows<n, SAMPLE_NEAREST>(s, c, out, dst->width, dst->height);
+            break;
+            case SAMPLE_BILINEAR:
+            remap_rows<n, SAMPLE_BILINEAR>(s, c, out, dst->width, dst->height);
+            break;
+            case SAMPLE_CATMULLROM:
+            remap_rows<n, SAMPLE_CATMULLROM>(s, c, out, dst->width, dst->height);
+            break;
+        }
+    }
+
+}
+
+ImageBase *remap (const ImageBase *src, const ImageBase *coords, SampleFilter filter,
+                  bool wrap_x, bool wrap_y)
+{
+    if (coords->channels() != 2)
+        EXCEPTEX << "Coordinate image must have 2 channels, got " << int(coords->channels()) << ENDL;
+    ImageBase *dst = image_alloc(coords->width, coords->height, src->channels(), src->hasAlpha());
+    switch (src->channels()) {
+        case 1: remap_n<1>(src, coords, dst, filter, wrap_x, wrap_y); break;
+        case 2: remap_n<2>(src, coords, dst, filter, wrap_x, wrap_y); break;
+        case 3: remap_n<3>(src, coords, dst, filter, wrap_x, wrap_y); break;
+        case 4: remap_n<4>(src, coords, dst, filter, wrap_x, wrap_y); break;
+        default:
+        delete dst;
+        EXCEPTEX << "Unsupported number of channels: " << int(src->channels()) << ENDL;
+    }
+    return dst;
+}
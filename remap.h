@@ -0,0 +1,36 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef REMAP_H
+#define REMAP_H
+
+#include "image.h"
+#include "sample.h"
+
+/** Resample src at the positions held in the 2 channel image coords, giving an image the size
+ * of coords with the channels of src.  Positions are in the units of src's pixel indexes, so a
+ * whole-numbered position reads that pixel exactly and coords holding each pixel's own position
+ * reproduces src.  Beyond the edges the image wraps around or the edge pixels are repeated, as
+ * in convolve. */
+ImageBase *remap (const ImageBase *src, const ImageBase *coords, SampleFilter filter,
+                  bool wrap_x, bool wrap_y);
+
+#endif
@@ -0,0 +1,170 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <cmath>
+
+#include <algorithm>
+
+#include "image.h"
+
+enum SampleFilter {
+    SAMPLE_NEAREST,
+    SAMPLE_BILINEAR,
+    SAMPLE_CATMULLROM
+};
+
+/** What a sample reads when its footprint falls outside the image, per axis. */
+enum SampleBorder {
+    SAMPLE_CLAMP,
+    SAMPLE_WRAP,
+    SAMPLE_MIRROR,
+    SAMPLE_COLOUR
+};
+
+/** Point sampling of an n-channel float buffer (as returned by ImageBase::raw) at continuous
+ * coordinates, where pixel (x,y) covers [x,x+1) by [y,y+1) so its centre is at (x+0.5,y+0.5).
+ * The filters are nearest, bilinear, and the Catmull-Rom cubic (which passes through the pixel
+ * values, so unlike a B-spline it does not blur).  SAMPLE_COLOUR reads the background colour
+ * for each tap outside the image.  Footprints entirely inside the image are read directly, so
+ * the border handling only costs anything near the edges. */
+template<chan_t n> struct Sampler2D {
+    const float *data;
+    long width, height;
+    SampleBorder borderX, borderY;
+    const float *bg;
+
+    Sampler2D (const float *data, uimglen_t width, uimglen_t height,
+               SampleBorder border_x, SampleBorder border_y, const float *bg)
+      : data(data), width(width), height(height), borderX(border_x), borderY(border_y), bg(bg)
+    { }
+
+    // Index of the pixel to read for coordinate i along an axis of length len, or -1 for the
+    // background colour.
+    static long resolve (long i, long len, SampleBorder border)
+    {
+        if (i >= 0 && i < len) return i;
+        switch (border) {
+            case SAMPLE_CLAMP: return i < 0 ? 0 : len - 1;
+            case SAMPLE_WRAP: i %= len; return i < 0 ? i + len : i;
+            case SAMPLE_MIRROR:
+            i %= 2*len;
+            if (i < 0) i += 2*len;
+            return i < len ? i : 2*len - 1 - i;
+            case SAMPLE_COLOUR: default: return -1;
+        }
+    }
+
+    const float *texel (long x, long y) const
+    {
+        x = resolve(x, width, borderX);
+        y = resolve(y, height, borderY);
+        if (x < 0 || y < 0) return bg;
+        return &data[(y*width + x) * n];
+    }
+
+    // Catmull-Rom weights for the 4 taps around a sample at fraction t past the second tap.
+    static void cubicWeights (float t, float *w)
+    {
+        float t2 = t*t, t3 = t2*t;
+        w[0] = 0.5f * (-t3 + 2*t2 - t);
+        w[1] = 0.5f * (3*t3 - 5*t2 + 2);
+        w[2] = 0.5f * (-3*t3 + 4*t2 + t);
+        w[3] = 0.5f * (t3 - t2);
+    }
+
+    void nearest (float x, float y, float *out) const
+    {
+        const float *p = texel(long(std::floor(x)), long(std::floor(y)));
+        for (chan_t c=0 ; c<n ; ++c) out[c] = p[c];
+    }
+
+    void bilinear (float x, float y, float *out) const
+    {
+        x -= 0.5f;
+        y -= 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        float tx = x - fx, ty = y - fy;
+        long ix = long(fx), iy = long(fy);
+        const float *p00, *p01, *p10, *p11;
+        if (ix >= 0 && iy >= 0 && ix+1 < width && iy+1 < height) {
+            p00 = &data[(iy*width + ix) * n];
+            p01 = p00 + n;
+            p10 = p00 + width*n;
+            p11 = p10 + n;
+        } else {
+            p00 = texel(ix, iy);
+            p01 = texel(ix+1, iy);
+            p10 = texel(ix, iy+1);
+            p11 = texel(ix+1, iy+1);
+        }
+        for (chan_t c=0 ; c<n ; ++c) {
+            float top = p00[c] + (p01[c] - p00[c]) * tx;
+            float bot = p10[c] + (p11[c] - p10[c]) * tx;
+            out[c] = top + (bot - top) * ty;
+        }
+    }
+
+    void catmullRom (float x, float y, float *out) const
+    {
+        x -= 0.5f;
+        y -= 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        float wx[4], wy[4];
+        cubicWeights(x - fx, wx);
+        cubicWeights(y - fy, wy);
+        long ix = long(fx) - 1, iy = long(fy) - 1;
+        bool inside = ix >= 0 && iy >= 0 && ix+3 < width && iy+3 < height;
+        for (chan_t c=0 ; c<n ; ++c) out[c] = 0;
+        for (int j=0 ; j<4 ; ++j) {
+            float row[n];
+            for (chan_t c=0 ; c<n ; ++c) row[c] = 0;
+            const float *line = inside ? &data[((iy+j)*width + ix) * n] : NULL;
+            for (int i=0 ; i<4 ; ++i) {
+                const float *p = inside ? line + i*n : texel(ix+i, iy+j);
+                for (chan_t c=0 ; c<n ; ++c) row[c] += wx[i] * p[c];
+            }
+            for (chan_t c=0 ; c<n ; ++c) out[c] += wy[j] * row[c];
+        }
+    }
+
+    void sample (SampleFilter filter, float x, float y, float *out) const
+    {
+        // Keep the integer conversions below defined for wild (or NaN) coordinates.
+        if (!(std::fabs(x) < 1e8f && std::fabs(y) < 1e8f)) {
+            if (x != x || y != y) {
+                for (chan_t c=0 ; c<n ; ++c) out[c] = bg[c];
+                return;
+            }
+            x = std::max(-1e8f, std::min(x, 1e8f));
+            y = std::max(-1e8f, std::min(y, 1e8f));
+        }
+        switch (filter) {
+            case SAMPLE_NEAREST: nearest(x, y, out); break;
+            case SAMPLE_BILINEAR: bilinear(x, y, out); break;
+            case SAMPLE_CATMULLROM: catmullRom(x, y, out); break;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,207 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <algorithm>
+
+#include <exception.h>
+
+#include "parallel.h"
+#include "sampler.h"
+
+namespace {
+
+    const float zero[4] = {0, 0, 0, 0};
+
+    // Next mip level: each pixel is the mean of the 2x2 block above it.  An odd last row or
+    // column is dropped, and a dimension of 1 stays 1.
+    void halve (const float *src, uimglen_t sw, uimglen_t sh, chan_t n,
+                float *dst, uimglen_t dw, uimglen_t dh)
+    {
+        parallel_for(dh, size_t(dw) * n * 4, [&] (size_t begin, size_t end) {
+            for (size_t y=begin ; y<end ; ++y) {
+                size_t y0 = std::min<size_t>(2*y, sh - 1), y1 = std::min<size_t>(2*y + 1, sh - 1);
+                for (size_t x=0 ; x<dw ; ++x) {
+                    size_t x0 = std::min<size_t>(2*x, sw - 1), x1 = std::min<size_t>(2*x + 1, sw - 1);
+                    for (chan_t c=0 ; c<n ; ++c) {
+                        dst[(y*dw + x)*n + c] = 0.25f * (src[(y0*sw + x0)*n + c] + src[(y0*sw + x1)*n + c]
+                                                       + src[(y1*sw + x0)*n + c] + src[(y1*sw + x1)*n + c]);
+                    }
+                }
+            }
+        });
+    }
+
+    chan_t first_channels (const std::vector<ImageBase*> &mips)
+    {
+        if (mips.empty()) EXCEPTEX << "A sampler needs at least one image." << ENDL;
+        return mips[0]->channels();
+    }
+
+}
+
+TextureSampler::TextureSampler (const std::vector<ImageBase*> &mips, SampleFilter filter,
+                                bool mip_linear, SampleBorder border, unsigned max_aniso)
+  : channels(first_channels(mips)), alpha(mips[0]->hasAlpha()), filter(filter),
+    mipLinear(mip_linear), border(border), maxAniso(std::max(1u, max_aniso))
+{
+    for (size_t i=0 ; i<mips.size() ; ++i) {
+        const ImageBase *img = mips[i];
+        if (img->channels() != channels || img->hasAlpha() != alpha)
+            EXCEPTEX << "Mip level " << i << " has a different number of channels." << ENDL;
+        if (img->width == 0 || img->height == 0)
+            EXCEPTEX << "Mip level " << i << " is empty." << ENDL;
+        Level l;
+        l.width = img->width;
+        l.height = img->height;
+        l.data.assign(img->raw(), img->raw() + size_t(l.width) * l.height * channels);
+        levels.push_back(l);
+    }
+    if (mips.size() > 1) return;
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Level &above = levels.back();
+        Level l;
+        l.width = std::max<uimglen_t>(1, above.width / 2);
+        l.height = std::max<uimglen_t>(1, above.height / 2);
+        l.data.resize(size_t(l.width) * l.height * channels);
+        halve(&above.data[0], above.width, above.height, channels, &l.data[0], l.width, l.height);
+        levels.push_back(l);
+    }
+}
+
+size_t TextureSampler::numBytes (void) const
+{
+    size_t r = 0;
+    for (const Level &l : levels) r += l.data.size() * sizeof(float);
+    return r;
+}
+
+template<chan_t n> void TextureSampler::sampleLevel (size_t level, float u, float v, float *out) const
+{
+    const Level &l = levels[level];
+    Sampler2D<n> s(&l.data[0], l.width, l.height, border, border, zero);
+    s.sample(filter, u * l.width, v * l.height, out);
+}
+
+template<chan_t n> void TextureSampler::sampleLod (float u, float v, float lod, float *out) const
+{
+    float top = levels.size() - 1;
+    lod = lod > 0 ? std::min(lod, top) : 0;
+    if (!mipLinear) {
+        sampleLevel<n>(size_t(lod + 0.5f), u, v, out);
+        return;
+    }
+    size_t l0 = size_t(lod);
+    float t = lod - l0;
+    sampleLevel<n>(l0, u, v, out);
+    if (t == 0) return;
+    float out1[n];
+    sampleLevel<n>(l0 + 1, u, v, out1);
+    for (chan_t c=0 ; c<n ; ++c) out[c] += (out1[c] - out[c]) * t;
+}
+
+// The level of detail and anisotropic sample count as in the EXT_texture_filter_anisotropic
+// specification: the footprint's axes are measured in texels of the top level.
+template<chan_t n> void TextureSampler::sampleGradT (float u, float v, float dudx, float dvdx,
+                                                     float dudy, float dvdy, float *out) const
+{
+    float w = width(), h = height();
+    float px = std::sqrt(dudx*dudx*w*w + dvdx*dvdx*h*h);
+    float py = std::sqrt(dudy*dudy*w*w + dvdy*dvdy*h*h);
+    float pmax = std::max(px, py), pmin = std::min(px, py);
+    float mu = px >= py ? dudx : dudy;
+    float mv = px >= py ? dvdx : dvdy;
+    unsigned samples = 1;
+    if (maxAniso > 1 && pmax > 0) {
+        float ratio = pmin > 0 ? pmax / pmin : maxAniso;
+        samples = ratio >= maxAniso ? maxAniso : unsigned(std::ceil(ratio));
+    }
+    float lod = pmax > 0 ? std::log2(pmax / samples) : 0;
+    if (samples == 1) {
+        sampleLod<n>(u, v, lod, out);
+        return;
+    }
+    for (chan_t c=0 ; c<n ; ++c) out[c] = 0;
+    for (unsigned i=0 ; i<samples ; ++i) {
+        float t = (i + 0.5f) / samples - 0.5f;
+        float tmp[n];
+        sampleLod<n>(u + t*mu, v + t*mv, lod, tmp);
+        for (chan_t c=0 ; c<n ; ++c) out[c] += tmp[c];
+    }
+    for (chan_t c=0 ; c<n ; ++c) out[c] /= samples;
+}
+
+template<chan_t n> void TextureSampler::sampleImageT (const float *uvs, uimglen_t w, uimglen_t h,
+                                                      float *out) const
+{
+    parallel_for(h, size_t(w) * 8 * maxAniso, [&] (size_t begin, size_t end) {
+        for (size_t y=begin ; y<end ; ++y) {
+            // Forward differences, backward on the last row or column.
+            size_t yn = y + 1 < h ? y + 1 : y, yp = y + 1 < h ? y : (y > 0 ? y - 1 : y);
+            for (size_t x=0 ; x<w ; ++x) {
+                size_t xn = x + 1 < w ? x + 1 : x, xp = x + 1 < w ? x : (x > 0 ? x - 1 : x);
+                const float *uv = &uvs[(y*w + x) * 2];
+                const float *ux0 = &uvs[(y*w + xp) * 2], *ux1 = &uvs[(y*w + xn) * 2];
+                const float *uy0 = &uvs[(yp*w + x) * 2], *uy1 = &uvs[(yn*w + x) * 2];
+                if (xn == xp) ux1 = ux0;
+                if (yn == yp) uy1 = uy0;
+                sampleGradT<n>(uv[0], uv[1], ux1[0] - ux0[0], ux1[1] - ux0[1],
+                               uy1[0] - uy0[0], uy1[1] - uy0[1], &out[(y*w + x) * n]);
+            }
+        }
+    });
+}
+
+void TextureSampler::sample (float u, float v, float lod, float *out) const
+{
+    switch (channels) {
+        case 1: sampleLod<1>(u, v, lod, out); break;
+        case 2: sampleLod<2>(u, v, lod, out); break;
+        case 3: sampleLod<3>(u, v, lod, out); break;
+        case 4: sampleLod<4>(u, v, lod, out); break;
+    }
+}
+
+void TextureSampler::sampleGrad (float u, float v, float dudx, float dvdx, float dudy, float dvdy,
+                                 float *out) const
+{
+    switch (channels) {
+        case 1: sampleGradT<1>(u, v, dudx, dvdx, dudy, dvdy, out); break;
+        case 2: sampleGradT<2>(u, v, dudx, dvdx, dudy, dvdy, out); break;
+        case 3: sampleGradT<3>(u, v, dudx, dvdx, dudy, dvdy, out); break;
+        case 4: sampleGradT<4>(u, v, dudx, dvdx, dudy, dvdy, out); break;
+    }
+}
+
+ImageBase *TextureSampler::sampleImage (const ImageBase *uvs) const
+{
+    if (uvs->channels() != 2)
+        EXCEPTEX << "Texture coordinate image must have 2 channels, got " << int(uvs->channels()) << ENDL;
+    ImageBase *r = image_alloc(uvs->width, uvs->height, channels, alpha);
+    switch (channels) {
+        case 1: sampleImageT<1>(uvs->raw(), uvs->width, uvs->height, r->raw()); break;
+        case 2: sampleImageT<2>(uvs->raw(), uvs->width, uvs->height, r->raw()); break;
+        case 3: sampleImageT<3>(uvs->raw(), uvs->width, uvs->height, r->raw()); break;
+        case 4: sampleImageT<4>(uvs->raw(), uvs->width, uvs->height, r->raw()); break;
+    }
+    return r;
+}
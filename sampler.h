@@ -0,0 +1,96 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <ostream>
+#include <vector>
+
+#include "image.h"
+#include "sample.h"
+
+/** A filtered texture lookup, with its own copy of a mip chain so that repeated lookups need
+ * neither Lua nor a rebuilt chain.  Texture coordinates (u,v) run from 0 to 1 across the image,
+ * v in the same direction as the pixel y index. */
+class TextureSampler {
+
+    struct Level {
+        uimglen_t width, height;
+        std::vector<float> data;
+    };
+
+    std::vector<Level> levels;
+
+    template<chan_t n> void sampleLevel (size_t level, float u, float v, float *out) const;
+    template<chan_t n> void sampleLod (float u, float v, float lod, float *out) const;
+    template<chan_t n> void sampleGradT (float u, float v, float dudx, float dvdx,
+                                         float dudy, float dvdy, float *out) const;
+    template<chan_t n> void sampleImageT (const float *uvs, uimglen_t w, uimglen_t h,
+                                          float *out) const;
+
+    public:
+
+    const chan_t channels;
+    const bool alpha;
+    /** Filter used within a mip level. */
+    const SampleFilter filter;
+    /** Whether to blend between the two nearest mip levels (trilinear filtering). */
+    const bool mipLinear;
+    const SampleBorder border;
+    /** Most samples taken along the long axis of an anisotropic footprint, 1 to disable. */
+    const unsigned maxAniso;
+
+    /** If given a single image, the rest of the chain is built from it with a 2x2 box filter,
+     * down to 1x1.  Otherwise mips is taken as the whole chain, largest first. */
+    TextureSampler (const std::vector<ImageBase*> &mips, SampleFilter filter, bool mip_linear,
+                    SampleBorder border, unsigned max_aniso);
+
+    uimglen_t width (void) const { return levels[0].width; }
+    uimglen_t height (void) const { return levels[0].height; }
+    size_t numLevels (void) const { return levels.size(); }
+    size_t numBytes (void) const;
+
+    /** Sample at the given level of detail (0 is the full size image, 1 the next mip, and so
+     * on, fractions blending between levels when mipLinear). */
+    void sample (float u, float v, float lod, float *out) const;
+
+    /** Sample a footprint given by the derivatives of (u,v) with respect to the x and y of
+     * whatever is being drawn, choosing the level of detail as a GPU does.  When the footprint
+     * is elongated, up to maxAniso samples are averaged along its long axis, each at the level
+     * of detail suited to the short axis. */
+    void sampleGrad (float u, float v, float dudx, float dvdx, float dudy, float dvdy,
+                     float *out) const;
+
+    /** Sample at each (u,v) of a 2 channel image, giving an image of the same size with this
+     * texture's channels.  Derivatives are the differences between neighbouring pixels of uvs,
+     * so the level of detail follows the mapping as it would on a GPU. */
+    ImageBase *sampleImage (const ImageBase *uvs) const;
+};
+
+static inline std::ostream &operator<<(std::ostream &o, const TextureSampler &s)
+{
+    o << "TextureSampler ("<<s.width()<<","<<s.height()<<")x"<<int(s.channels)
+      << " " << s.numLevels() << " levels [0x"<<&s<<"]";
+    return o;
+}
+
+#endif
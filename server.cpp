@@ -0,0 +1,441 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#ifndef WIN32
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+
+#include "server.h"
+#include "interpreter.h"
+
+#ifdef WIN32
+
+int server_run (const std::string &, unsigned)
+{
+    std::cerr << "ERROR: --serve is not supported on this platform." << std::endl;
+    return EXIT_FAILURE;
+}
+
+int client_run (const std::string &, const Work &, const std::vector<std::string> &)
+{
+    std::cerr << "ERROR: --client is not supported on this platform." << std::endl;
+    return EXIT_FAILURE;
+}
+
+#else
+
+// Protocol (all integers in host byte order, client and server are on the same machine):
+//
+// client -> server: RequestHeader, with the client's stdout and stderr attached as SCM_RIGHTS
+// client -> server: payload of RequestHeader::length bytes, a sequence of NUL terminated
+//                   strings each beginning with a tag character:
+//                       C<dir>      the working directory to execute in
+//                       F<file>     execute a file (like -f)
+//                       E<snippet>  execute a snippet (like -e)
+//                       A<arg>      a commandline arg, passed as ...
+// server -> client: int32_t exit status
+//
+// If the connection is closed without a status, the worker died executing the request.
+
+static const uint32_t REQUEST_MAGIC = 0x474d494c;  // "LIMG"
+static const uint32_t MAX_PAYLOAD = 16 * 1024 * 1024;
+
+struct RequestHeader {
+    uint32_t magic;
+    uint32_t length;
+};
+
+static bool write_all (int fd, const void *buf, size_t sz)
+{
+    const char *p = static_cast<const char*>(buf);
+    while (sz > 0) {
+        ssize_t r = write(fd, p, sz);
+        if (r == -1 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        sz -= r;
+    }
+    return true;
+}
+
+static bool read_all (int fd, void *buf, size_t sz)
+{
+    char *p = static_cast<char*>(buf);
+    while (sz > 0) {
+        ssize_t r = read(fd, p, sz);
+        if (r == -1 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        sz -= r;
+    }
+    return true;
+}
+
+static bool make_address (const std::string &socket_path, sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (socket_path.length() >= sizeof addr.sun_path) {
+        std::cerr << "ERROR: Socket path too long: \"" << socket_path << "\"" << std::endl;
+        return false;
+    }
+    strcpy(addr.sun_path, socket_path.c_str());
+    return true;
+}
+
+static void flush_all (void)
+{
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(NULL);
+}
+
+
+/////////////
+// SERVER  //
+/////////////
+
+static volatile sig_atomic_t server_stopping = 0;
+static void server_stop_handler (int) { server_stopping = 1; }
+
+// Receive the header and the client's stdout/stderr.  Returns false if the request is malformed.
+static bool receive_header (int conn, RequestHeader &header, int (&fds)[2])
+{
+    char control[CMSG_SPACE(sizeof fds)];
+    memset(control, 0, sizeof control);
+    iovec iov;
+    iov.iov_base = &header;
+    iov.iov_len = sizeof header;
+    msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    ssize_t r;
+    do {
+        r = recvmsg(conn, &msg, 0);
+    } while (r == -1 && errno == EINTR);
+    if (r != sizeof header) return false;
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+        || cmsg->cmsg_len != CMSG_LEN(sizeof fds)) {
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof fds);
+    if (header.magic != REQUEST_MAGIC || header.length > MAX_PAYLOAD) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    return true;
+}
+
+static int32_t execute_request (const std::vector<char> &payload)
+{
+    std::string dir;
+    Work work;
+    std::vector<std::string> args;
+    size_t i = 0;
+    while (i < payload.size()) {
+        std::string str(&payload[i]);
+        i += str.length() + 1;
+        if (str.length() == 0) continue;
+        std::string val = str.substr(1);
+        switch (str[0]) {
+            case 'C': dir = val; break;
+            case 'F': work.push_back(std::pair<FileOrSnippet,std::string>(F, val)); break;
+            case 'E': work.push_back(std::pair<FileOrSnippet,std::string>(S, val)); break;
+            case 'A': args.push_back(val); break;
+            default:
+            std::cerr << "ERROR: Malformed request." << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (dir != "" && chdir(dir.c_str()) == -1) {
+        std::cerr << "ERROR: Could not change to client's directory: \"" << dir << "\": "
+                  << strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Only the interpreter is per-request, so that globals set by one script are not seen by the
+    // next.  FreeImage, fonts, etc. were set up before the fork and are reused.
+    interpreter_init();
+    bool ok = interpreter_exec_work(work, args);
+    interpreter_shutdown();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void serve_connection (int conn)
+{
+    RequestHeader header;
+    int fds[2];
+    if (!receive_header(conn, header, fds)) return;
+
+    // Terminate so the payload can be parsed as strings, even if the client did not.
+    std::vector<char> payload(header.length + 1, '\0');
+    if (!read_all(conn, &payload[0], header.length)) {
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    payload.pop_back();
+
+    // Temporarily give the client our stdout and stderr.
+    flush_all();
+    int saved_out = dup(1);
+    int saved_err = dup(2);
+    dup2(fds[0], 1);
+    dup2(fds[1], 2);
+    close(fds[0]);
+    close(fds[1]);
+
+    int32_t status = execute_request(payload);
+
+    flush_all();
+    dup2(saved_out, 1);
+    dup2(saved_err, 2);
+    close(saved_out);
+    close(saved_err);
+
+    write_all(conn, &status, sizeof status);
+}
+
+static void server_worker (int listener)
+{
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    // A client going away must not kill the worker when the script writes output.
+    signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        int conn = accept(listener, NULL, NULL);
+        if (conn == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            _exit(EXIT_FAILURE);
+        }
+        serve_connection(conn);
+        close(conn);
+    }
+}
+
+static pid_t spawn_worker (int listener)
+{
+    flush_all();
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+    } else if (pid == 0) {
+        server_worker(listener);
+        _exit(EXIT_SUCCESS);
+    }
+    return pid;
+}
+
+int server_run (const std::string &socket_path, unsigned jobs)
+{
+    if (jobs < 1) jobs = 1;
+
+    sockaddr_un addr;
+    if (!make_address(socket_path, addr)) return EXIT_FAILURE;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == -1) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    // Remove a socket left behind by a previous server.
+    unlink(socket_path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof addr) == -1) {
+        std::cerr << "ERROR: Could not bind to \"" << socket_path << "\": " << strerror(errno) << std::endl;
+        close(listener);
+        return EXIT_FAILURE;
+    }
+    if (listen(listener, 128) == -1) {
+        perror("listen");
+        close(listener);
+        unlink(socket_path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // No SA_RESTART, so that waitpid is interrupted.
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = server_stop_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    std::vector<pid_t> workers;
+    for (unsigned j=0 ; j<jobs ; ++j) {
+        pid_t pid = spawn_worker(listener);
+        if (pid != -1) workers.push_back(pid);
+    }
+    if (workers.size() == 0) {
+        close(listener);
+        unlink(socket_path.c_str());
+        return EXIT_FAILURE;
+    }
+    std::cerr << "Serving on \"" << socket_path << "\" with " << workers.size() << " workers." << std::endl;
+
+    while (!server_stopping) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1) {
+            if (errno == EINTR) continue;
+            perror("waitpid");
+            break;
+        }
+        for (unsigned j=0 ; j<workers.size() ; ++j) {
+            if (workers[j] != pid) continue;
+            if (server_stopping) break;
+            if (WIFSIGNALED(status)) {
+                std::cerr << "Worker " << pid << " killed by signal " << WTERMSIG(status) << ", restarting." << std::endl;
+            } else {
+                std::cerr << "Worker " << pid << " exited with status " << WEXITSTATUS(status) << ", restarting." << std::endl;
+            }
+            workers[j] = spawn_worker(listener);
+        }
+    }
+
+    for (unsigned j=0 ; j<workers.size() ; ++j) {
+        if (workers[j] != -1) kill(workers[j], SIGTERM);
+    }
+    for (unsigned j=0 ; j<workers.size() ; ++j) {
+        if (workers[j] == -1) continue;
+        int status;
+        while (waitpid(workers[j], &status, 0) == -1 && errno == EINTR) { }
+    }
+    close(listener);
+    unlink(socket_path.c_str());
+    std::cerr << "Server terminated." << std::endl;
+    return EXIT_SUCCESS;
+}
+
+
+/////////////
+// CLIENT  //
+/////////////
+
+static void append_field (std::vector<char> &payload, char tag, const std::string &val)
+{
+    payload.push_back(tag);
+    payload.insert(payload.end(), val.begin(), val.end());
+    payload.push_back('\0');
+}
+
+int client_run (const std::string &socket_path, const Work &work, const std::vector<std::string> &args)
+{
+    sockaddr_un addr;
+    if (!make_address(socket_path, addr)) return EXIT_FAILURE;
+
+    std::vector<char> payload;
+    {
+        char *cwd = getcwd(NULL, 0);
+        if (cwd != NULL) {
+            append_field(payload, 'C', cwd);
+            free(cwd);
+        }
+    }
+    for (Work::const_iterator i=work.begin(),i_=work.end() ; i!=i_ ; ++i) {
+        append_field(payload, i->first == F ? 'F' : 'E', i->second);
+    }
+    for (unsigned i=0 ; i<args.size() ; ++i) {
+        append_field(payload, 'A', args[i]);
+    }
+    if (payload.size() > MAX_PAYLOAD) {
+        std::cerr << "ERROR: Request too large." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (conn == -1) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    if (connect(conn, reinterpret_cast<sockaddr*>(&addr), sizeof addr) == -1) {
+        std::cerr << "ERROR: Could not connect to luaimg server at \"" << socket_path << "\": "
+                  << strerror(errno) << std::endl;
+        close(conn);
+        return EXIT_FAILURE;
+    }
+
+    RequestHeader header;
+    header.magic = REQUEST_MAGIC;
+    header.length = payload.size();
+    int fds[2] = { 1, 2 };
+    char control[CMSG_SPACE(sizeof fds)];
+    memset(control, 0, sizeof control);
+    iovec iov;
+    iov.iov_base = &header;
+    iov.iov_len = sizeof header;
+    msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof fds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof fds);
+
+    ssize_t r;
+    do {
+        r = sendmsg(conn, &msg, 0);
+    } while (r == -1 && errno == EINTR);
+    if (r != sizeof header || (payload.size() > 0 && !write_all(conn, &payload[0], payload.size()))) {
+        std::cerr << "ERROR: Could not send request to luaimg server: " << strerror(errno) << std::endl;
+        close(conn);
+        return EXIT_FAILURE;
+    }
+
+    int32_t status;
+    if (!read_all(conn, &status, sizeof status)) {
+        std::cerr << "ERROR: luaimg server worker died while executing the request." << std::endl;
+        close(conn);
+        return EXIT_FAILURE;
+    }
+    close(conn);
+    return status;
+}
+
+#endif
@@ -0,0 +1,44 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <vector>
+
+#include "interpreter.h"
+
+/** Listen on the given Unix domain socket, executing requests sent by
+ * client_run on a pool of worker processes.  The workers are forked after
+ * FreeImage and the text subsystem have been initialised, so those (and any
+ * fonts they have cached) stay warm between requests.  Each request runs in a
+ * fresh interpreter, with stdout and stderr connected to those of the client,
+ * and in the client's working directory.  Workers that die are replaced.
+ * Returns when the server is terminated with SIGINT or SIGTERM. */
+int server_run (const std::string &socket_path, unsigned jobs);
+
+/** Send the work and args to a server listening on the given socket and wait
+ * for it to complete.  The output of the scripts appears on this process's
+ * stdout and stderr.  Returns the exit status to use for this process. */
+int client_run (const std::string &socket_path, const Work &work, const std::vector<std::string> &args);
+
+#endif
@@ -0,0 +1,81 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstdlib>
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "startup_profile.h"
+
+namespace {
+    struct Phase {
+        std::string name;
+        unsigned long long micros;
+        unsigned count;
+    };
+    bool enabled = false;
+    unsigned long long enabled_at;
+    std::vector<Phase> phases;
+}
+
+static void report_at_exit (void)
+{
+    startup_profile_report(std::cerr);
+}
+
+void startup_profile_enable (void)
+{
+    if (enabled) return;
+    enabled = true;
+    enabled_at = micros();
+    atexit(report_at_exit);
+}
+
+void startup_profile_record (const std::string &phase, unsigned long long elapsed)
+{
+    if (!enabled) return;
+    for (unsigned i=0 ; i<phases.size() ; ++i) {
+        if (phases[i].name == phase) {
+            phases[i].micros += elapsed;
+            phases[i].count++;
+            return;
+        }
+    }
+    Phase p = { phase, elapsed, 1 };
+    phases.push_back(p);
+}
+
+void startup_profile_report (std::ostream &o)
+{
+    if (!enabled) return;
+    o << "Startup profile (ms):" << std::endl;
+    for (unsigned i=0 ; i<phases.size() ; ++i) {
+        o << "    " << std::left << std::setw(28) << phases[i].name << std::right << std::fixed
+          << std::setprecision(3) << std::setw(10) << phases[i].micros / 1000.0;
+        if (phases[i].count > 1) o << "  (" << phases[i].count << " times)";
+        o << std::endl;
+    }
+    o << "    " << std::left << std::setw(28) << "total (whole run)" << std::right << std::fixed
+      << std::setprecision(3) << std::setw(10) << (micros() - enabled_at) / 1000.0 << std::endl;
+}
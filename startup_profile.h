@@ -0,0 +1,49 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef STARTUP_PROFILE_H
+#define STARTUP_PROFILE_H
+
+#include <ostream>
+#include <string>
+
+#include <sleep.h>
+
+/** Start recording phases (until this is called, recording does nothing).  The
+ * report is written to stderr when the process exits. */
+void startup_profile_enable (void);
+
+/** Add the given time to the named phase. */
+void startup_profile_record (const std::string &phase, unsigned long long elapsed);
+
+/** Write the time taken by each phase, in the order they were first recorded. */
+void startup_profile_report (std::ostream &o);
+
+/** Records the time between construction and destruction as the named phase. */
+class StartupPhase {
+    const char *name;
+    unsigned long long before;
+    public:
+    StartupPhase (const char *name) : name(name), before(micros()) { }
+    ~StartupPhase (void) { startup_profile_record(name, micros() - before); }
+};
+
+#endif
@@ -0,0 +1,302 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstdlib>
+
+#include <algorithm>
+
+#include <exception.h>
+
+#include "parallel.h"
+#include "stencil.h"
+
+namespace {
+
+    // Rows of output computed by one parallel_for item, each needing its own copy of the halo.
+    const uimglen_t BAND = 64;
+
+    size_t edge (ptrdiff_t i, size_t len, bool wrap)
+    {
+        if (wrap) {
+            i %= ptrdiff_t(len);
+            return i < 0 ? i + len : i;
+        }
+        return i < 0 ? 0 : size_t(i) >= len ? len - 1 : size_t(i);
+    }
+
+    // The kernels compute a row of w pixels at a time.  rows[j] points at pixel x=0 of row
+    // y+j-ry of the padded band, so rows[j][(x+dx)*n] is valid for dx in -rx..rx.  Most work a
+    // pixel at a time, through per_pixel.
+
+    template<class K> void per_pixel (const K &kern, const float *const *rows, size_t w, float *out,
+                                      chan_t n)
+    {
+        for (size_t x=0 ; x<w ; ++x) kern.pixel(rows, x, &out[x * n]);
+    }
+
+    template<chan_t n> struct Linear {
+        const StencilKernel &k;
+        void operator() (const float *const *rows, size_t w, float *out) const
+        { per_pixel(*this, rows, w, out, n); }
+        void pixel (const float *const *rows, size_t x, float *out) const
+        {
+            float acc[n];
+            for (chan_t c=0 ; c<n ; ++c) acc[c] = 0;
+            const float *w = &k.weights[0];
+            for (size_t j=0 ; j<=2*k.ry ; ++j) {
+                const float *p = &rows[j][(ptrdiff_t(x) - ptrdiff_t(k.rx)) * n];
+                for (size_t i=0 ; i<=2*k.rx ; ++i, ++w, p+=n)
+                    for (chan_t c=0 ; c<n ; ++c) acc[c] += *w * p[c];
+            }
+            for (chan_t c=0 ; c<n ; ++c) out[c] = acc[c];
+        }
+    };
+
+    struct OpMean {
+        static float step (float acc, float v) { return acc + v; }
+        static float finish (float acc, size_t count) { return acc / count; }
+    };
+    struct OpMin {
+        static float step (float acc, float v) { return std::min(acc, v); }
+        static float finish (float acc, size_t) { return acc; }
+    };
+    struct OpMax {
+        static float step (float acc, float v) { return std::max(acc, v); }
+        static float finish (float acc, size_t) { return acc; }
+    };
+
+    template<chan_t n, class Op> struct Reduce {
+        const StencilKernel &k;
+        void operator() (const float *const *rows, size_t w, float *out) const
+        { per_pixel(*this, rows, w, out, n); }
+        void pixel (const float *const *rows, size_t x, float *out) const
+        {
+            float acc[n];
+            const float *first = &rows[0][(ptrdiff_t(x) - ptrdiff_t(k.rx)) * n];
+            for (chan_t c=0 ; c<n ; ++c) acc[c] = first[c];
+            for (size_t j=0 ; j<=2*k.ry ; ++j) {
+                const float *p = &rows[j][(ptrdiff_t(x) - ptrdiff_t(k.rx)) * n];
+                for (size_t i=0 ; i<=2*k.rx ; ++i, p+=n) {
+                    if (p == first) continue;
+                    for (chan_t c=0 ; c<n ; ++c) acc[c] = Op::step(acc[c], p[c]);
+                }
+            }
+            size_t count = (2*k.rx + 1) * (2*k.ry + 1);
+            for (chan_t c=0 ; c<n ; ++c) out[c] = Op::finish(acc[c], count);
+        }
+    };
+
+    template<chan_t n> struct Expand {
+        const StencilKernel &k;
+        void operator() (const float *const *rows, size_t w, float *out) const
+        { per_pixel(*this, rows, w, out, n); }
+        void pixel (const float *const *rows, size_t x, float *out) const
+        {
+            const float *centre = &rows[k.ry][x * n];
+            if (centre[n-1] > 0) {
+                for (chan_t c=0 ; c<n ; ++c) out[c] = centre[c];
+                return;
+            }
+            float acc[n];
+            for (chan_t c=0 ; c<n ; ++c) acc[c] = 0;
+            float alpha = 0;
+            for (size_t j=0 ; j<=2*k.ry ; ++j) {
+                const float *p = &rows[j][(ptrdiff_t(x) - ptrdiff_t(k.rx)) * n];
+                for (size_t i=0 ; i<=2*k.rx ; ++i, p+=n) {
+                    float a = p[n-1];
+                    if (a <= 0) continue;
+                    for (chan_t c=0 ; c<n-1 ; ++c) acc[c] += a * p[c];
+                    acc[n-1] += a;
+                    alpha = std::max(alpha, a);
+                }
+            }
+            if (acc[n-1] <= 0) {
+                for (chan_t c=0 ; c<n ; ++c) out[c] = centre[c];
+                return;
+            }
+            for (chan_t c=0 ; c<n-1 ; ++c) out[c] = acc[c] / acc[n-1];
+            out[n-1] = alpha;
+        }
+    };
+
+    // Counts live cells in each column of the neighbourhood once, then slides the window along
+    // the row, so the cost per cell does not grow with rx.
+    template<chan_t n> struct Life {
+        const StencilKernel &k;
+        // Next state indexed by the live cells in the neighbourhood, counting the cell itself,
+        // for dead then live cells.
+        std::vector<float> next;
+
+        Life (const StencilKernel &k) : k(k)
+        {
+            size_t cells = k.birth.size();
+            next.resize(2 * (cells + 1), 0);
+            for (size_t c=0 ; c<cells ; ++c) {
+                next[c] = k.birth[c];
+                next[cells + 1 + c + 1] = k.survive[c];
+            }
+        }
+
+        void operator() (const float *const *rows, size_t w, float *out) const
+        {
+            size_t span = w + 2*k.rx;
+            size_t cells = k.birth.size();
+            std::vector<unsigned> columns(span, 0);
+            for (size_t j=0 ; j<=2*k.ry ; ++j) {
+                const float *p = &rows[j][-ptrdiff_t(k.rx) * n];
+                for (size_t i=0 ; i<span ; ++i) columns[i] += p[i * n] > 0.5f;
+            }
+            unsigned count = 0;
+            for (size_t i=0 ; i<2*k.rx ; ++i) count += columns[i];
+            const float *centre = rows[k.ry];
+            for (size_t x=0 ; x<w ; ++x) {
+                count += columns[x + 2*k.rx];
+                size_t alive = centre[x * n] > 0.5f;
+                out[x * n] = next[alive * (cells + 1) + count];
+                for (chan_t c=1 ; c<n ; ++c) out[x * n + c] = centre[x * n + c];
+                count -= columns[x];
+            }
+        }
+    };
+
+    template<chan_t n, class K> void run (float *data, uimglen_t w, uimglen_t h, const K &kern,
+                                          const StencilKernel &k, unsigned iterations,
+                                          bool wrap_x, bool wrap_y)
+    {
+        if (w == 0 || h == 0 || iterations == 0) return;
+        std::vector<float> other(size_t(w) * h * n);
+        float *a = data, *b = &other[0];
+        size_t pad_w = w + 2*size_t(k.rx);
+        size_t bands = (h + BAND - 1) / BAND;
+        size_t cost = size_t(BAND) * w * (2*k.rx + 1) * (2*k.ry + 1) * n;
+        for (unsigned it=0 ; it<iterations ; ++it) {
+            parallel_for(bands, cost, [&] (size_t begin, size_t end) {
+                std::vector<float> pad;
+                std::vector<const float *> rows(2*k.ry + 1);
+                for (size_t band=begin ; band<end ; ++band) {
+                    size_t y0 = band * BAND, y1 = std::min<size_t>(y0 + BAND, h);
+                    size_t pad_h = y1 - y0 + 2*k.ry;
+                    pad.resize(pad_h * pad_w * n);
+                    // Copy the band and its halo, resolving the edges once here.
+                    for (size_t py=0 ; py<pad_h ; ++py) {
+                        const float *src = &a[edge(ptrdiff_t(y0 + py) - ptrdiff_t(k.ry), h, wrap_y) * w * n];
+                        float *dst = &pad[py * pad_w * n];
+                        std::copy(src, src + size_t(w) * n, dst + size_t(k.rx) * n);
+                        for (size_t i=0 ; i<k.rx ; ++i) {
+                            const float *l = &src[edge(ptrdiff_t(i) - ptrdiff_t(k.rx), w, wrap_x) * n];
+                            const float *r = &src[edge(w + i, w, wrap_x) * n];
+                            std::copy(l, l + n, dst + i * n);
+                            std::copy(r, r + n, dst + (k.rx + w + i) * n);
+                        }
+                    }
+                    for (size_t y=y0 ; y<y1 ; ++y) {
+                        for (size_t j=0 ; j<rows.size() ; ++j)
+                            rows[j] = &pad[((y - y0 + j) * pad_w + k.rx) * n];
+                        kern(&rows[0], w, &b[y * w * n]);
+                    }
+                }
+            });
+            std::swap(a, b);
+        }
+        if (a != data) std::copy(a, a + size_t(w) * h * n, data);
+    }
+
+    template<chan_t n> void run_n (float *data, uimglen_t w, uimglen_t h, const StencilKernel &k,
+                                   unsigned iterations, bool wrap_x, bool wrap_y)
+    {
+        switch (k.op) {
+            case STENCIL_LINEAR: run<n>(data, w, h, Linear<n>{k}, k, iterations, wrap_x, wrap_y); break;
+            case STENCIL_MEAN: run<n>(data, w, h, Reduce<n, OpMean>{k}, k, iterations, wrap_x, wrap_y); break;
+            case STENCIL_MIN: run<n>(data, w, h, Reduce<n, OpMin>{k}, k, iterations, wrap_x, wrap_y); break;
+            case STENCIL_MAX: run<n>(data, w, h, Reduce<n, OpMax>{k}, k, iterations, wrap_x, wrap_y); break;
+            case STENCIL_EXPAND: run<n>(data, w, h, Expand<n>{k}, k, iterations, wrap_x, wrap_y); break;
+            case STENCIL_LIFE: run<n>(data, w, h, Life<n>(k), k, iterations, wrap_x, wrap_y); break;
+        }
+    }
+
+    // A list of neighbour counts: single digits ("23"), or comma-separated numbers and ranges
+    // ("2,3" or "33-57").
+    std::vector<bool> parse_counts (const std::string &rule, const std::string &s, size_t max)
+    {
+        std::vector<bool> r(max + 1, false);
+        if (s.find_first_of(",-") == std::string::npos) {
+            for (char c : s) {
+                if (c < '0' || c > '9') EXCEPTEX << "Bad life rule: \"" << rule << "\"" << ENDL;
+                size_t v = c - '0';
+                if (v > max) EXCEPTEX << "Life rule \"" << rule << "\" counts more than " << max << " neighbours." << ENDL;
+                r[v] = true;
+            }
+            return r;
+        }
+        size_t pos = 0;
+        while (pos <= s.size()) {
+            size_t comma = s.find(',', pos);
+            if (comma == std::string::npos) comma = s.size();
+            std::string item = s.substr(pos, comma - pos);
+            size_t dash = item.find('-');
+            std::string lo_s = item.substr(0, dash);
+            std::string hi_s = dash == std::string::npos ? lo_s : item.substr(dash + 1);
+            if (lo_s.empty() || hi_s.empty() || lo_s.find_first_not_of("0123456789") != std::string::npos
+                || hi_s.find_first_not_of("0123456789") != std::string::npos)
+                EXCEPTEX << "Bad life rule: \"" << rule << "\"" << ENDL;
+            size_t lo = strtoul(lo_s.c_str(), NULL, 10), hi = strtoul(hi_s.c_str(), NULL, 10);
+            if (hi > max || lo > hi)
+                EXCEPTEX << "Life rule \"" << rule << "\" has a bad count for " << max << " neighbours." << ENDL;
+            for (size_t v=lo ; v<=hi ; ++v) r[v] = true;
+            pos = comma + 1;
+        }
+        return r;
+    }
+
+}
+
+void stencil_parse_life (const std::string &rule, StencilKernel &k)
+{
+    size_t slash = rule.find('/');
+    if (rule.size() < 3 || rule[0] != 'B' || slash == std::string::npos
+        || slash + 1 >= rule.size() || rule[slash + 1] != 'S')
+        EXCEPTEX << "Expected a life rule like \"B3/S23\", got \"" << rule << "\"" << ENDL;
+    size_t max = (2*size_t(k.rx) + 1) * (2*size_t(k.ry) + 1) - 1;
+    k.op = STENCIL_LIFE;
+    k.birth = parse_counts(rule, rule.substr(1, slash - 1), max);
+    k.survive = parse_counts(rule, rule.substr(slash + 2), max);
+}
+
+ImageBase *stencil (const ImageBase *src, const StencilKernel &k, unsigned iterations,
+                    bool wrap_x, bool wrap_y)
+{
+    if (k.op == STENCIL_LINEAR && k.weights.size() != (2*size_t(k.rx) + 1) * (2*size_t(k.ry) + 1))
+        EXCEPTEX << "Stencil weights do not match the radius." << ENDL;
+    if (k.op == STENCIL_EXPAND && !src->hasAlpha())
+        EXCEPTEX << "Expanding needs an image with an alpha channel." << ENDL;
+    ImageBase *r = src->clone(false, false);
+    float *data = r->raw();
+    switch (r->channels()) {
+        case 1: run_n<1>(data, r->width, r->height, k, iterations, wrap_x, wrap_y); break;
+        case 2: run_n<2>(data, r->width, r->height, k, iterations, wrap_x, wrap_y); break;
+        case 3: run_n<3>(data, r->width, r->height, k, iterations, wrap_x, wrap_y); break;
+        case 4: run_n<4>(data, r->width, r->height, k, iterations, wrap_x, wrap_y); break;
+        default:
+        delete r;
+        EXCEPTEX << "Unsupported number of channels: " << int(src->channels()) << ENDL;
+    }
+    return r;
+}
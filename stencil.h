@@ -0,0 +1,74 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <string>
+#include <vector>
+
+#include "image.h"
+
+enum StencilOp {
+    STENCIL_LINEAR,
+    STENCIL_MEAN,
+    STENCIL_MIN,
+    STENCIL_MAX,
+    STENCIL_EXPAND,
+    STENCIL_LIFE
+};
+
+/** One step of a stencil computation, reading the (2*rx+1) by (2*ry+1) neighbourhood of each
+ * pixel.
+ *
+ * STENCIL_LINEAR: each channel becomes the weighted sum of its neighbourhood, weights in
+ * row-major order from the bottom left, so the weight at (i,j) applies to the pixel at offset
+ * (i-rx, j-ry).
+ *
+ * STENCIL_MEAN, STENCIL_MIN, STENCIL_MAX: each channel becomes the mean, minimum or maximum of
+ * its neighbourhood.
+ *
+ * STENCIL_EXPAND: pixels with alpha 0 take the alpha-weighted mean colour of their
+ * neighbourhood, and its largest alpha, so opaque regions grow by the radius each step.
+ *
+ * STENCIL_LIFE: a life-like cellular automaton on the first channel (alive if over 0.5), other
+ * channels are left alone.  A dead cell becomes alive if its number of live neighbours is in
+ * birth, a live one stays alive if the number is in survive. */
+struct StencilKernel {
+    StencilOp op;
+    uimglen_t rx, ry;
+    std::vector<float> weights;
+    std::vector<bool> birth, survive;
+};
+
+/** Set k to the life-like rule in the usual notation, e.g. "B3/S23" for Conway's game of life.
+ * For neighbourhoods with more than 9 neighbours, counts can be comma-separated numbers or
+ * ranges, e.g. "B34-45/S33-57".  k.rx and k.ry must already be set.  Throws on a bad rule. */
+void stencil_parse_life (const std::string &rule, StencilKernel &k);
+
+/** Run the given number of steps of the stencil.  Beyond the edges the image wraps around or
+ * the edge pixels are repeated, as in convolve.  Each step reads one buffer and writes the
+ * other; bands of rows are processed in parallel, each copied with its halo into a padded
+ * buffer first so the stencil itself never has to check for edges. */
+ImageBase *stencil (const ImageBase *src, const StencilKernel &k, unsigned iterations,
+                    bool wrap_x, bool wrap_y);
+
+#endif
@@ -25,7 +25,10 @@
 #include <cmath>
 #include <cstring>
 
+#include <algorithm>
 #include <string>
+#include <map>
+#include <vector>
 #include <iostream>
 #include <fstream>
 
@@ -33,9 +36,11 @@
 // wrap in #ifdef to keep makedepend happy
 #ifdef FT_FREETYPE_H
 #include FT_FREETYPE_H
+#include FT_OUTLINE_H
 #endif
 
-FT_Library ft2;
+static FT_Library ft2;
+static bool ft2_initialised = false;
 
 #include <lua_util.h>
 #include <unicode_util.h>
@@ -43,194 +48,602 @@ FT_Library ft2;
 
 #include "text.h"
 #include "image.h"
+#include "startup_profile.h"
+#include "distance_transform.h"
+#include "parallel.h"
+
+
+//////////////////////
+// FACE/GLYPH CACHE //
+//////////////////////
+
+// Faces stay open for the life of the process (or until text_shutdown), so a font file is only
+// parsed once.  The pixel size is part of the face's state in FreeType, so remember it and only
+// change it when necessary.
+namespace {
+    struct CachedFace {
+        FT_Face face;
+        uimglen_t w, h;
+    };
+
+    // Everything that influences the rendered bitmap.  The pen position only matters to within a
+    // pixel, since the whole pixels just translate the bitmap.
+    struct GlyphKey {
+        FT_Face face;
+        uimglen_t w, h;
+        FT_Fixed xx, xy, yx, yy;
+        FT_Pos fracX, fracY;
+        unsigned long cp;
+        bool operator< (const GlyphKey &o) const
+        {
+            if (face != o.face) return face < o.face;
+            if (w != o.w) return w < o.w;
+            if (h != o.h) return h < o.h;
+            if (xx != o.xx) return xx < o.xx;
+            if (xy != o.xy) return xy < o.xy;
+            if (yx != o.yx) return yx < o.yx;
+            if (yy != o.yy) return yy < o.yy;
+            if (fracX != o.fracX) return fracX < o.fracX;
+            if (fracY != o.fracY) return fracY < o.fracY;
+            return cp < o.cp;
+        }
+    };
+
+    // The rendered glyph, with coverage as 0-255 regardless of whether FreeType rendered it mono
+    // or gray.  left/top are relative to the whole-pixel part of the pen position.
+    struct CachedGlyph {
+        simglen_t left, top;
+        uimglen_t width, rows;
+        FT_Vector advance;
+        std::vector<unsigned char> coverage;  // rows * width, top row first
+    };
+
+    std::map<std::string, CachedFace> face_cache;
+    std::map<GlyphKey, CachedGlyph> glyph_cache;
+    size_t glyph_cache_bytes = 0;
+
+    // Beyond this, the glyph cache is emptied at the start of the next text operation.
+    const size_t GLYPH_CACHE_MAX_BYTES = 64 * 1024 * 1024;
+}
+
+static void text_cache_clear (void)
+{
+    glyph_cache.clear();
+    glyph_cache_bytes = 0;
+    for (auto &pair : face_cache) FT_Done_Face(pair.second.face);
+    face_cache.clear();
+}
 
 void text_init (void)
 {
+    if (ft2_initialised) return;
+    StartupPhase phase("FreeType");
     if (0 != FT_Init_FreeType(&ft2)) {
         EXCEPT << "Couldn't initialise the FreeType2 font library." << std::endl;
     }
+    ft2_initialised = true;
 }
 
-Image<1,0> *make_text_codepoint (const std::string &font, uimglen_t font_w, uimglen_t font_h, unsigned long cp)
+void text_shutdown (void)
+{
+    if (!ft2_initialised) return;
+    text_cache_clear();
+    FT_Done_FreeType(ft2);
+    ft2_initialised = false;
+}
+
+// Glyph pointers returned by get_glyph remain valid until the next call of this.
+static void text_begin (void)
 {
-    FT_Face face;
-    int error = FT_New_Face(ft2, font.c_str(), 0, &face);
-    if (error == FT_Err_Unknown_File_Format) {
-        EXCEPT<<"Unknown file format reading: "<<font<<std::endl;
-    } else if (error != 0) {
-        EXCEPT<<"Could not read "<<font<<": "<<error<<std::endl;
+    text_init();
+    if (glyph_cache_bytes > GLYPH_CACHE_MAX_BYTES) {
+        glyph_cache.clear();
+        glyph_cache_bytes = 0;
     }
+}
 
-    error = FT_Set_Pixel_Sizes(face, font_w, font_h);
-    if (0 != error) {
-        FT_Done_Face(face);
-        EXCEPT<<"Could not set font size ("<<font_w<<","<<font_h<<") for font "<<font<<": "<<error<<std::endl;
+static FT_Face get_face (const std::string &font, uimglen_t font_w, uimglen_t font_h)
+{
+    auto it = face_cache.find(font);
+    if (it == face_cache.end()) {
+        FT_Face face;
+        int error = FT_New_Face(ft2, font.c_str(), 0, &face);
+        if (error == FT_Err_Unknown_File_Format) {
+            EXCEPT<<"Unknown file format reading: "<<font<<std::endl;
+        } else if (error != 0) {
+            EXCEPT<<"Could not read "<<font<<": "<<error<<std::endl;
+        }
+        CachedFace cf = { face, 0, 0 };
+        it = face_cache.insert(std::make_pair(font, cf)).first;
+    }
+
+    CachedFace &cf = it->second;
+    if (cf.w != font_w || cf.h != font_h) {
+        int error = FT_Set_Pixel_Sizes(cf.face, font_w, font_h);
+        if (0 != error) {
+            // Size is now unknown.
+            cf.w = 0;
+            cf.h = 0;
+            EXCEPT<<"Could not set font size ("<<font_w<<","<<font_h<<") for font "<<font<<": "<<error<<std::endl;
+        }
+        cf.w = font_w;
+        cf.h = font_h;
     }
-    
-    error = FT_Load_Char(face, cp, FT_LOAD_RENDER);
+    return cf.face;
+}
+
+// Round towards -infinity to whole pixels.
+static FT_Pos pixel_floor (FT_Pos v)
+{
+    return v >= 0 ? v / 64 : -((-v + 63) / 64);
+}
+
+// Render (or fetch from the cache) the glyph for the given codepoint with the pen at the given
+// position.  The transform is only applied to scalable fonts, bitmap fonts ignore it.  The glyph's
+// bitmap must be offset by pixel_floor(pen) when drawing.
+static const CachedGlyph &get_glyph (FT_Face face, const std::string &font, uimglen_t font_w, uimglen_t font_h,
+                                     const FT_Matrix *matrix, const FT_Vector &pen, unsigned long cp)
+{
+    bool scalable = FT_IS_SCALABLE(face);
+    GlyphKey key;
+    key.face = face;
+    key.w = font_w;
+    key.h = font_h;
+    key.xx = matrix == NULL ? 0x10000L : matrix->xx;
+    key.xy = matrix == NULL ? 0 : matrix->xy;
+    key.yx = matrix == NULL ? 0 : matrix->yx;
+    key.yy = matrix == NULL ? 0x10000L : matrix->yy;
+    key.fracX = scalable ? pen.x - 64 * pixel_floor(pen.x) : 0;
+    key.fracY = scalable ? pen.y - 64 * pixel_floor(pen.y) : 0;
+    key.cp = cp;
+
+    auto it = glyph_cache.find(key);
+    if (it != glyph_cache.end()) return it->second;
+
+    FT_Matrix m;
+    m.xx = key.xx;
+    m.xy = key.xy;
+    m.yx = key.yx;
+    m.yy = key.yy;
+    FT_Vector delta;
+    delta.x = key.fracX;
+    delta.y = key.fracY;
+    FT_Set_Transform(face, &m, &delta);
+
+    int error = FT_Load_Char(face, cp, FT_LOAD_RENDER);
     if (0 != error) {
-        FT_Done_Face(face);
         EXCEPT<<"Could not load glyph "<<cp<<" for font "<<font<<": "<<error<<std::endl;
     }
 
+    const FT_Bitmap &bitmap = face->glyph->bitmap;
+    CachedGlyph g;
+    g.left = face->glyph->bitmap_left;
+    g.top = face->glyph->bitmap_top;
+    g.width = bitmap.width;
+    g.rows = bitmap.rows;
+    g.advance = face->glyph->advance;
+    g.coverage.resize(g.width * g.rows);
+    if (bitmap.num_grays == 1) {
+        for (uimglen_t q=0 ; q<g.rows ; q++) {
+            for (uimglen_t p=0 ; p<g.width ; p++) {
+                unsigned char byte = (unsigned char)(bitmap.buffer[q * bitmap.pitch + p/8]);
+                g.coverage[q*g.width + p] = ((byte >> (7-(p % 8))) & 1) ? 255 : 0;
+            }
+        }
+    } else if (bitmap.num_grays == 256) {
+        for (uimglen_t q=0 ; q<g.rows ; q++) {
+            for (uimglen_t p=0 ; p<g.width ; p++) {
+                g.coverage[q*g.width + p] = (unsigned char)(bitmap.buffer[q * bitmap.pitch + p]);
+            }
+        }
+    } else {
+        EXCEPTEX<<font<<": "<<bitmap.num_grays<<std::endl;
+    }
+
+    glyph_cache_bytes += sizeof(GlyphKey) + sizeof(CachedGlyph) + g.coverage.size();
+    return glyph_cache.insert(std::make_pair(key, g)).first->second;
+}
+
+// Blend the glyph's coverage into the image with the glyph origin at (x,y), clipping the glyph
+// against the image once rather than checking every pixel.  Same result as drawPixelSafe with a
+// white Colour<1,1> and the coverage as alpha.
+static void draw_glyph (Image<1,0> *img, const CachedGlyph &g, simglen_t x, simglen_t y)
+{
+    static float alpha[256];
+    static bool alpha_initialised = false;
+    if (!alpha_initialised) {
+        for (unsigned i=0 ; i<256 ; ++i) alpha[i] = i / 255.0f;
+        alpha_initialised = true;
+    }
+
+    // Glyph rows go down from the top, image rows go up.
+    simglen_t left = x + g.left;
+    simglen_t top = y + g.top;
+    simglen_t p0 = std::max(simglen_t(0), -left);
+    simglen_t p1 = std::min(simglen_t(g.width), simglen_t(img->width) - left);
+    simglen_t q0 = std::max(simglen_t(0), top - simglen_t(img->height) + 1);
+    simglen_t q1 = std::min(simglen_t(g.rows), top + 1);
+    if (p0 >= p1 || q0 >= q1) return;
+
+    float *data = img->raw();
+    for (simglen_t q=q0 ; q<q1 ; q++) {
+        const unsigned char *src = &g.coverage[q*g.width + p0];
+        float *dst = &data[(top - q) * simglen_t(img->width) + left + p0];
+        for (simglen_t p=p0 ; p<p1 ; p++) {
+            unsigned char c = *(src++);
+            if (c != 0) {
+                float a = alpha[c];
+                *dst = a + (1 - a) * *dst;
+            }
+            dst++;
+        }
+    }
+}
+
+
+//////////////////////
+// TEXT RENDERING   //
+//////////////////////
+
+Image<1,0> *make_text_codepoint (const std::string &font, uimglen_t font_w, uimglen_t font_h, unsigned long cp)
+{
+    text_begin();
+
+    FT_Face face = get_face(font, font_w, font_h);
+
+    FT_Vector pen;
+    pen.x = 0;
+    pen.y = 0;
+    const CachedGlyph &g = get_glyph(face, font, font_w, font_h, NULL, pen, cp);
+
     // record max in here
-    simglen_t max_x = (face->glyph->advance.x-1) / 64;
+    simglen_t max_x = (g.advance.x-1) / 64;
     simglen_t max_y = face->size->metrics.ascender/64;
     simglen_t min_x = 0; // always zero
     simglen_t min_y = (face->size->metrics.descender+1) / 64;
 
-    //std::cout << "(" << min_x << "," << min_y << ") (" << max_x << "," << max_y << ")" << std::endl;
-    //std::cout << bool(FT_IS_SCALABLE(face)) << std::endl;
-
     Colour<1,0> bg(0);
-    Colour<1,1> fg(1);
     Image<1,0> *img = image_make<1,0>(max_x-min_x+1, max_y-min_y+1, bg);
 
-    if (face->glyph->bitmap.num_grays == 1) {
-        for (uimglen_t p=0 ; p<face->glyph->bitmap.width ; p++) {
-            for (uimglen_t q=0 ; q<face->glyph->bitmap.rows ; q++) {
-                unsigned char byte = (unsigned char)(face->glyph->bitmap.buffer[q * face->glyph->bitmap.pitch + p/8]);
-                unsigned char v = (byte >> (7-(p % 8))) & 1;
-                img->drawPixelSafe(simglen_t(face->glyph->bitmap_left) + p - min_x,
-                                   simglen_t(face->glyph->bitmap_top) - q - min_y,
-                                   &fg,
-                                   float(v));
-            }
+    draw_glyph(img, g, -min_x, -min_y);
+
+    return img;
+}
+
+//////////////////////
+// DISTANCE FIELDS  //
+//////////////////////
+
+namespace {
+    struct OutlineSegment {
+        float x0, y0, x1, y1;
+    };
+
+    // Collects the outline as line segments in pixel units, flattening curves.
+    struct OutlineFlattener {
+        std::vector<OutlineSegment> segments;
+        float x, y;
+
+        void lineTo (float x1, float y1)
+        {
+            OutlineSegment s = { x, y, x1, y1 };
+            segments.push_back(s);
+            x = x1;
+            y = y1;
+        }
+
+        // Enough pieces that each is at most about half a pixel long.
+        static unsigned pieces (float length)
+        {
+            unsigned n = unsigned(ceilf(length * 2));
+            return n < 1 ? 1 : n > 64 ? 64 : n;
+        }
+
+        static int moveToCB (const FT_Vector *to, void *user)
+        {
+            OutlineFlattener *self = static_cast<OutlineFlattener*>(user);
+            self->x = to->x / 64.0f;
+            self->y = to->y / 64.0f;
+            return 0;
+        }
+
+        static int lineToCB (const FT_Vector *to, void *user)
+        {
+            static_cast<OutlineFlattener*>(user)->lineTo(to->x / 64.0f, to->y / 64.0f);
+            return 0;
         }
-    } else if (face->glyph->bitmap.num_grays == 256) {
-        for (uimglen_t p=0 ; p<face->glyph->bitmap.width ; p++) {
-            for (uimglen_t q=0 ; q<face->glyph->bitmap.rows ; q++) {
-                img->drawPixelSafe(simglen_t(face->glyph->bitmap_left) + p - min_x,
-                                   simglen_t(face->glyph->bitmap_top) - q - min_y,
-                                   &fg,
-                                   (unsigned char)(face->glyph->bitmap.buffer[q * face->glyph->bitmap.pitch + p]) / 255.0f);
+
+        static int conicToCB (const FT_Vector *control, const FT_Vector *to, void *user)
+        {
+            OutlineFlattener *self = static_cast<OutlineFlattener*>(user);
+            float x0 = self->x, y0 = self->y;
+            float cx = control->x / 64.0f, cy = control->y / 64.0f;
+            float x1 = to->x / 64.0f, y1 = to->y / 64.0f;
+            unsigned n = pieces(hypotf(cx-x0, cy-y0) + hypotf(x1-cx, y1-cy));
+            for (unsigned i=1 ; i<=n ; ++i) {
+                float t = float(i) / n, u = 1 - t;
+                self->lineTo(u*u*x0 + 2*u*t*cx + t*t*x1, u*u*y0 + 2*u*t*cy + t*t*y1);
             }
+            return 0;
         }
-    } else {
-        FT_Done_Face(face);
-        EXCEPTEX<<font<<": "<<face->glyph->bitmap.num_grays<<std::endl;
-    }
 
-    FT_Done_Face(face);
+        static int cubicToCB (const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to,
+                              void *user)
+        {
+            OutlineFlattener *self = static_cast<OutlineFlattener*>(user);
+            float x0 = self->x, y0 = self->y;
+            float ax = control1->x / 64.0f, ay = control1->y / 64.0f;
+            float bx = control2->x / 64.0f, by = control2->y / 64.0f;
+            float x1 = to->x / 64.0f, y1 = to->y / 64.0f;
+            unsigned n = pieces(hypotf(ax-x0, ay-y0) + hypotf(bx-ax, by-ay) + hypotf(x1-bx, y1-by));
+            for (unsigned i=1 ; i<=n ; ++i) {
+                float t = float(i) / n, u = 1 - t;
+                self->lineTo(u*u*u*x0 + 3*u*u*t*ax + 3*u*t*t*bx + t*t*t*x1,
+                             u*u*u*y0 + 3*u*u*t*ay + 3*u*t*t*by + t*t*t*y1);
+            }
+            return 0;
+        }
+    };
+}
 
-    return img;
+// Signed distance from (px,py) to the outline, positive inside, using the outline's fill rule.
+static float outline_distance (const std::vector<OutlineSegment> &segments, bool even_odd, float px, float py)
+{
+    float best = EDT_INF;
+    int winding = 0;
+    for (const OutlineSegment &s : segments) {
+        float dx = s.x1 - s.x0, dy = s.y1 - s.y0;
+        float len2 = dx*dx + dy*dy;
+        float t = len2 == 0 ? 0 : ((px - s.x0)*dx + (py - s.y0)*dy) / len2;
+        t = t < 0 ? 0 : t > 1 ? 1 : t;
+        float ex = s.x0 + t*dx - px, ey = s.y0 + t*dy - py;
+        float d2 = ex*ex + ey*ey;
+        if (d2 < best) best = d2;
+
+        // Crossings of the ray going right from the point.
+        if ((s.y0 <= py) != (s.y1 <= py)) {
+            float x = s.x0 + (py - s.y0) / dy * dx;
+            if (x > px) winding += dy > 0 ? 1 : -1;
+        }
+    }
+    bool inside = even_odd ? (winding & 1) != 0 : winding != 0;
+    float d = sqrtf(best);
+    return inside ? d : -d;
 }
 
-Image<1,0> *make_text (const std::string &font, uimglen_t font_w, uimglen_t font_h, const std::string &text,
-                       float xx, float xy, float yx, float yy)
+Image<1,0> *make_text_codepoint_sdf (const std::string &font, uimglen_t font_w, uimglen_t font_h, unsigned long cp,
+                                     float spread)
 {
-    FT_Face face;
-    int error = FT_New_Face(ft2, font.c_str(), 0, &face);
-    if (error == FT_Err_Unknown_File_Format) {
-        EXCEPT<<"Unknown file format reading: "<<font<<std::endl;
-    } else if (error != 0) {
-        EXCEPT<<"Could not read "<<font<<": "<<error<<std::endl;
+    text_begin();
+
+    FT_Face face = get_face(font, font_w, font_h);
+
+    // Same box as make_text_codepoint, plus room for the field to fall off.
+    FT_Set_Transform(face, NULL, NULL);
+    int error = FT_Load_Char(face, cp, FT_LOAD_NO_BITMAP);
+    if (0 != error) {
+        EXCEPT<<"Could not load glyph "<<cp<<" for font "<<font<<": "<<error<<std::endl;
+    }
+    simglen_t pad = simglen_t(ceilf(spread));
+    simglen_t max_x = (face->glyph->advance.x-1) / 64 + pad;
+    simglen_t max_y = face->size->metrics.ascender/64 + pad;
+    simglen_t min_x = -pad;
+    simglen_t min_y = (face->size->metrics.descender+1) / 64 - pad;
+    uimglen_t width = max_x - min_x + 1;
+    uimglen_t height = max_y - min_y + 1;
+
+    if (face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
+        // Bitmap font, so fall back to the distance transform of its rendering.
+        FT_Vector pen;
+        pen.x = 0;
+        pen.y = 0;
+        const CachedGlyph &g = get_glyph(face, font, font_w, font_h, NULL, pen, cp);
+        Colour<1,0> bg(0);
+        Image<1,0> *mask = image_make<1,0>(width, height, bg);
+        draw_glyph(mask, g, -min_x, -min_y);
+        Image<1,0> *img = sdf_from_mask(mask, 0.5f, spread);
+        delete mask;
+        return img;
     }
 
-    error = FT_Set_Pixel_Sizes(face, font_w, font_h);
+    OutlineFlattener flattener;
+    flattener.x = 0;
+    flattener.y = 0;
+    FT_Outline_Funcs funcs;
+    funcs.move_to = OutlineFlattener::moveToCB;
+    funcs.line_to = OutlineFlattener::lineToCB;
+    funcs.conic_to = OutlineFlattener::conicToCB;
+    funcs.cubic_to = OutlineFlattener::cubicToCB;
+    funcs.shift = 0;
+    funcs.delta = 0;
+    error = FT_Outline_Decompose(&face->glyph->outline, &funcs, &flattener);
     if (0 != error) {
-        FT_Done_Face(face);
-        EXCEPT<<"Could not set font size ("<<font_w<<","<<font_h<<") for font "<<font<<": "<<error<<std::endl;
+        EXCEPT<<"Could not decompose outline of glyph "<<cp<<" for font "<<font<<": "<<error<<std::endl;
     }
-    
-    FT_Matrix     matrix;
-    matrix.xx = 0x10000L * xx;
-    matrix.xy = 0x10000L * xy;
-    matrix.yx = 0x10000L * yx;
-    matrix.yy = 0x10000L * yy;
+    bool even_odd = (face->glyph->outline.flags & FT_OUTLINE_EVEN_ODD_FILL) != 0;
+
+    // Sample at pixel centres, matching where make_text_codepoint puts the rendered pixels.
+    Image<1,0> *img = new Image<1,0>(width, height);
+    float *data = img->raw();
+    const std::vector<OutlineSegment> &segments = flattener.segments;
+    parallel_for(height, width * (segments.size() + 1), [&] (size_t begin, size_t end) {
+        for (size_t y=begin ; y<end ; ++y) {
+            float py = simglen_t(y) + min_y - 0.5f;
+            for (uimglen_t x=0 ; x<width ; ++x) {
+                float px = simglen_t(x) + min_x + 0.5f;
+                float d = segments.size() == 0 ? -EDT_INF : outline_distance(segments, even_odd, px, py);
+                data[y*width + x] = sdf_normalise(d, spread);
+            }
+        }
+    });
+
+    return img;
+}
+
+
+namespace {
+    // A line of text laid out with the pen starting at (0,0), and its bounding box in pixels
+    // (which always includes the origin).
+    struct TextLayout {
+        std::vector<std::pair<const CachedGlyph*, FT_Vector>> glyphs;
+        simglen_t minX, minY, maxX, maxY;
+        uimglen_t width (void) const { return maxX - minX + 1; }
+        uimglen_t height (void) const { return maxY - minY + 1; }
+    };
+}
 
+static void layout_text (FT_Face face, const std::string &font, uimglen_t font_w, uimglen_t font_h,
+                         const FT_Matrix &matrix, const std::string &text, TextLayout &layout)
+{
     FT_Vector pen;
     pen.x = 0;
     pen.y = 0;
 
     // record max in here
-    simglen_t max_x = 0;
-    simglen_t max_y = 0;
-    simglen_t min_x = 0;
-    simglen_t min_y = 0;
+    layout.maxX = 0;
+    layout.maxY = 0;
+    layout.minX = 0;
+    layout.minY = 0;
 
-    // calculate size
     for (size_t i=0 ; i<text.length() ; ++i) {
         unsigned long cp = decode_utf8(text, i);
 
-        FT_Set_Transform(face, &matrix, &pen);
-
-        error = FT_Load_Char(face, cp, FT_LOAD_RENDER);
-        if (0 != error) {
-            FT_Done_Face(face);
-            EXCEPT<<"Could not load glyph "<<cp<<" for font "<<font<<": "<<error<<std::endl;
-        }
-
-        for (uimglen_t p=0 ; p<face->glyph->bitmap.width ; p++) {
-            for (uimglen_t q=0 ; q<face->glyph->bitmap.rows ; q++) {
-                simglen_t x = simglen_t(face->glyph->bitmap_left) + p;
-                simglen_t y = simglen_t(face->glyph->bitmap_top) - q;
-                if (!FT_IS_SCALABLE(face)) {
-                    x += pen.x / 64;
-                    y += pen.y / 64;
-                }
-                if (x > max_x) max_x = x;
-                if (y > max_y) max_y = y;
-                if (x < min_x) min_x = x;
-                if (y < min_y) min_y = y;
-            }
+        const CachedGlyph &g = get_glyph(face, font, font_w, font_h, &matrix, pen, cp);
+
+        FT_Vector origin;
+        origin.x = pixel_floor(pen.x);
+        origin.y = pixel_floor(pen.y);
+        layout.glyphs.push_back(std::make_pair(&g, origin));
+
+        if (g.width > 0 && g.rows > 0) {
+            simglen_t x0 = origin.x + g.left;
+            simglen_t y1 = origin.y + g.top;
+            simglen_t x1 = x0 + simglen_t(g.width) - 1;
+            simglen_t y0 = y1 - simglen_t(g.rows) + 1;
+            if (x1 > layout.maxX) layout.maxX = x1;
+            if (y1 > layout.maxY) layout.maxY = y1;
+            if (x0 < layout.minX) layout.minX = x0;
+            if (y0 < layout.minY) layout.minY = y0;
         }
 
-        pen.x += face->glyph->advance.x;
-        pen.y += face->glyph->advance.y;
+        pen.x += g.advance.x;
+        pen.y += g.advance.y;
     }
+}
 
-    Colour<1,0> bg(0);
-    Colour<1,1> fg(1);
-    Image<1,0> *img = image_make<1,0>(max_x-min_x+1, max_y-min_y+1, bg);
+// Draw the text so that the bottom left of its bounding box is at (x,y).
+static void draw_layout (Image<1,0> *img, const TextLayout &layout, simglen_t x, simglen_t y)
+{
+    for (const auto &glyph : layout.glyphs) {
+        draw_glyph(img, *glyph.first, x + glyph.second.x - layout.minX, y + glyph.second.y - layout.minY);
+    }
+}
 
-    pen.x = 0;
-    pen.y = 0;
+Image<1,0> *make_text (const std::string &font, uimglen_t font_w, uimglen_t font_h, const std::string &text,
+                       float xx, float xy, float yx, float yy)
+{
+    text_begin();
 
-    // draw
-    for (size_t i=0 ; i<text.length() ; ++i) {
+    FT_Face face = get_face(font, font_w, font_h);
 
-        FT_Set_Transform(face, &matrix, &pen);
+    FT_Matrix     matrix;
+    matrix.xx = 0x10000L * xx;
+    matrix.xy = 0x10000L * xy;
+    matrix.yx = 0x10000L * yx;
+    matrix.yy = 0x10000L * yy;
 
-        unsigned long cp = decode_utf8(text, i);
+    TextLayout layout;
+    layout_text(face, font, font_w, font_h, matrix, text, layout);
 
-        error = FT_Load_Char(face, cp, FT_LOAD_RENDER);
-        if (0 != error) {
-            FT_Done_Face(face);
-            EXCEPT<<"Could not load glyph "<<cp<<" for font "<<font<<": "<<error<<std::endl;
-        }
-
-        if (face->glyph->bitmap.num_grays == 1) {
-            for (uimglen_t p=0 ; p<face->glyph->bitmap.width ; p++) {
-                for (uimglen_t q=0 ; q<face->glyph->bitmap.rows ; q++) {
-                    unsigned char byte = (unsigned char)(face->glyph->bitmap.buffer[q * face->glyph->bitmap.pitch + p/8]);
-                    unsigned char v = (byte >> (7-(p % 8))) & 1;
-                    img->drawPixelSafe(simglen_t(face->glyph->bitmap_left) + p - min_x + simglen_t(pen.x/64),
-                                       simglen_t(face->glyph->bitmap_top) - q - min_y + simglen_t(pen.y/64),
-                                       &fg,
-                                       float(v));
-                }
-            }
-        } else if (face->glyph->bitmap.num_grays == 256) {
-            for (uimglen_t p=0 ; p<face->glyph->bitmap.width ; p++) {
-                for (uimglen_t q=0 ; q<face->glyph->bitmap.rows ; q++) {
-                    img->drawPixelSafe(simglen_t(face->glyph->bitmap_left) + p - min_x,
-                                       simglen_t(face->glyph->bitmap_top) - q - min_y,
-                                       &fg,
-                                       (unsigned char)(face->glyph->bitmap.buffer[q * face->glyph->bitmap.pitch + p]) / 255.0f);
-                }
-            }
-        } else {
-            FT_Done_Face(face);
-            EXCEPTEX<<font<<": "<<face->glyph->bitmap.num_grays<<std::endl;
-        }
+    Colour<1,0> bg(0);
+    Image<1,0> *img = image_make<1,0>(layout.width(), layout.height(), bg);
+
+    draw_layout(img, layout, 0, 0);
+
+    return img;
+}
+
+static uimglen_t next_power_of_two (uimglen_t v)
+{
+    uimglen_t r = 1;
+    while (r < v) r *= 2;
+    return r;
+}
+
+Image<1,0> *make_text_batch (const std::string &font, uimglen_t font_w, uimglen_t font_h,
+                             const std::vector<std::string> &texts, const TextBatchOptions &opts,
+                             std::vector<TextBatchRect> &rects)
+{
+    text_begin();
+
+    FT_Face face = get_face(font, font_w, font_h);
+
+    FT_Matrix matrix;
+    matrix.xx = 0x10000L;
+    matrix.xy = 0;
+    matrix.yx = 0;
+    matrix.yy = 0x10000L;
+
+    std::vector<TextLayout> layouts(texts.size());
+    uimglen_t widest = 0;
+    double area = 0;
+    for (size_t i=0 ; i<texts.size() ; ++i) {
+        layout_text(face, font, font_w, font_h, matrix, texts[i], layouts[i]);
+        uimglen_t w = layouts[i].width() + opts.padding;
+        uimglen_t h = layouts[i].height() + opts.padding;
+        widest = std::max(widest, w);
+        area += double(w) * h;
+    }
 
-        pen.x += face->glyph->advance.x;
-        pen.y += face->glyph->advance.y;
+    // Without a given width, aim for roughly square.
+    uimglen_t atlas_width = opts.width;
+    if (atlas_width == 0) atlas_width = std::max(widest, uimglen_t(ceil(sqrt(area)))) + opts.padding;
+    if (opts.powerOfTwo) atlas_width = next_power_of_two(atlas_width);
+    if (widest + opts.padding > atlas_width) {
+        EXCEPT << "Text of width " << widest - opts.padding << " does not fit in an atlas of width "
+               << atlas_width << " with padding " << opts.padding << "." << ENDL;
+    }
 
+    // Shelf packing, tallest first.  Positions are measured from the top left while packing, since
+    // the height is not yet known.
+    std::vector<size_t> order(texts.size());
+    for (size_t i=0 ; i<order.size() ; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return layouts[a].height() > layouts[b].height();
+    });
+
+    rects.resize(texts.size());
+    uimglen_t shelf_top = opts.padding;
+    uimglen_t shelf_height = 0;
+    uimglen_t x = opts.padding;
+    for (size_t i : order) {
+        const TextLayout &layout = layouts[i];
+        if (x + layout.width() + opts.padding > atlas_width) {
+            shelf_top += shelf_height + opts.padding;
+            shelf_height = 0;
+            x = opts.padding;
+        }
+        rects[i].x = x;
+        rects[i].y = shelf_top;
+        rects[i].w = layout.width();
+        rects[i].h = layout.height();
+        x += layout.width() + opts.padding;
+        shelf_height = std::max(shelf_height, layout.height());
     }
+    uimglen_t atlas_height = shelf_top + shelf_height + opts.padding;
+    if (opts.powerOfTwo) atlas_height = next_power_of_two(atlas_height);
 
-    FT_Done_Face(face);
+    Colour<1,0> bg(0);
+    Image<1,0> *img = image_make<1,0>(atlas_width, atlas_height, bg);
+
+    for (size_t i=0 ; i<texts.size() ; ++i) {
+        TextBatchRect &r = rects[i];
+        // Convert to image coordinates, where y points up.
+        r.y = atlas_height - r.y - r.h;
+        r.originX = simglen_t(r.x) - layouts[i].minX;
+        r.originY = simglen_t(r.y) - layouts[i].minY;
+        draw_layout(img, layouts[i], r.x, r.y);
+    }
 
     return img;
 }
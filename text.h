@@ -26,15 +26,49 @@
 
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include "image.h"
 
+/** Initialise FreeType, if not already done.  This happens automatically the
+ * first time text is rendered. */
 void text_init (void);
 
+void text_shutdown (void);
+
 Image<1,0> *make_text_codepoint (const std::string &font, uimglen_t font_w, uimglen_t font_h, unsigned long cp);
 
 Image<1,0> *make_text (const std::string &font, uimglen_t font_w, uimglen_t font_h, const std::string &text,
                        float xx, float xy, float yx, float yy);
 
+/** A signed distance field of the glyph, computed from its outline at the
+ * given size rather than from a rendering.  The image covers the same area as
+ * make_text_codepoint, plus spread pixels on every side.  See sdf_from_mask for
+ * the meaning of spread.  Bitmap fonts fall back to the distance transform of
+ * the rendered glyph. */
+Image<1,0> *make_text_codepoint_sdf (const std::string &font, uimglen_t font_w, uimglen_t font_h, unsigned long cp,
+                                     float spread);
+
+struct TextBatchOptions {
+    uimglen_t width;  // 0 means choose automatically
+    uimglen_t padding;  // empty pixels around every string
+    bool powerOfTwo;
+    TextBatchOptions (void) : width(0), padding(1), powerOfTwo(false) { }
+};
+
+/** Where a string was placed in the atlas.  The rectangle has its bottom left at
+ * (x,y) and is sized as text() would size it.  The origin is where the pen
+ * started, i.e. the left end of the baseline. */
+struct TextBatchRect {
+    uimglen_t x, y, w, h;
+    simglen_t originX, originY;
+};
+
+/** Render all the strings, packed into a single image.  rects receives one
+ * rectangle per string, in the same order. */
+Image<1,0> *make_text_batch (const std::string &font, uimglen_t font_w, uimglen_t font_h,
+                             const std::vector<std::string> &texts, const TextBatchOptions &opts,
+                             std::vector<TextBatchRect> &rects);
+
 
 #endif
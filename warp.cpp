@@ -0,0 +1,126 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <exception.h>
+
+#include "parallel.h"
+#include "warp.h"
+
+namespace {
+
+    // Output is produced in square tiles so that when the transform rotates or shears, the
+    // source pixels read by neighbouring output rows are still in cache.
+    const uimglen_t TILE = 64;
+
+    // The source position is linear in the output x along a row, so the homogeneous coordinates
+    // are stepped by the first column of the inverse rather than recomputed per pixel.  They are
+    // kept in double so they do not drift across a wide tile.
+    template<chan_t n, SampleFilter f> void warp_tiles (const Sampler2D<n> &s, const double *inv,
+                                                        float *out, uimglen_t w, uimglen_t h)
+    {
+        const float *bg = s.bg;
+        size_t tiles_y = (h + TILE - 1) / TILE;
+        size_t cost = size_t(TILE) * w * (f == SAMPLE_CATMULLROM ? 16 : f == SAMPLE_BILINEAR ? 4 : 1);
+        parallel_for(tiles_y, cost, [&] (size_t begin, size_t end) {
+            for (size_t ty=begin ; ty<end ; ++ty) {
+                uimglen_t y0 = ty * TILE;
+                uimglen_t y1 = std::min(y0 + TILE, h);
+                for (uimglen_t x0=0 ; x0<w ; x0+=TILE) {
+                    uimglen_t x1 = std::min(x0 + TILE, w);
+                    for (uimglen_t y=y0 ; y<y1 ; ++y) {
+                        double ox = x0 + 0.5, oy = y + 0.5;
+                        double sx = inv[0]*ox + inv[1]*oy + inv[2];
+                        double sy = inv[3]*ox + inv[4]*oy + inv[5];
+                        double sw = inv[6]*ox + inv[7]*oy + inv[8];
+                        float *o = &out[(size_t(y)*w + x0) * n];
+                        for (uimglen_t x=x0 ; x<x1 ; ++x, o+=n, sx+=inv[0], sy+=inv[3], sw+=inv[6]) {
+                            if (!(sw > 0)) {
+                                for (chan_t c=0 ; c<n ; ++c) o[c] = bg[c];
+                                continue;
+                            }
+                            double rw = 1 / sw;
+                            s.sample(f, float(sx * rw), float(sy * rw), o);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    template<chan_t n> void warp_n (const ImageBase *src, const double *inv, ImageBase *dst,
+                                    SampleFilter filter, SampleBorder border, const float *bg)
+    {
+        Sampler2D<n> s(src->raw(), src->width, src->height, border, border, bg);
+        float *out = dst->raw();
+        switch (filter) {
+            case SAMPLE_NEAREST:
+            warp_tiles<n, SAMPLE_NEAREST>(s, inv, out, dst->width, dst->height);
+            break;
+            case SAMPLE_BILINEAR:
+            warp_tiles<n, SAMPLE_BILINEAR>(s, inv, out, dst->width, dst->height);
+            break;
+            case SAMPLE_CATMULLROM:
+            warp_tiles<n, SAMPLE_CATMULLROM>(s, inv, out, dst->width, dst->height);
+            break;
+        }
+    }
+
+}
+
+ImageBase *warp (const ImageBase *src, const double *m, uimglen_t out_width, uimglen_t out_height,
+                 SampleFilter filter, SampleBorder border, const ColourBase *bg_)
+{
+    // A projective matrix is only defined up to scale, including its sign, but the sign of w
+    // decides which side of the horizon is drawn.  Take the side the centre of the source is on.
+    double cx = src->width / 2.0, cy = src->height / 2.0;
+    double sign = m[6]*cx + m[7]*cy + m[8] < 0 ? -1 : 1;
+    double mm[9];
+    for (int i=0 ; i<9 ; ++i) mm[i] = sign * m[i];
+    m = mm;
+
+    // Inverse by the adjugate, divided by det so that w keeps its sign.
+    double inv[9] = {
+        m[4]*m[8] - m[5]*m[7], m[2]*m[7] - m[1]*m[8], m[1]*m[5] - m[2]*m[4],
+        m[5]*m[6] - m[3]*m[8], m[0]*m[8] - m[2]*m[6], m[2]*m[3] - m[0]*m[5],
+        m[3]*m[7] - m[4]*m[6], m[1]*m[6] - m[0]*m[7], m[0]*m[4] - m[1]*m[3],
+    };
+    double det = m[0]*inv[0] + m[1]*inv[3] + m[2]*inv[6];
+    if (det == 0 || !std::isfinite(det)) EXCEPTEX << "Warp matrix is singular." << ENDL;
+    for (int i=0 ; i<9 ; ++i) inv[i] /= det;
+
+    float zero[4] = {0, 0, 0, 0};
+    const float *bg = bg_ == NULL ? zero : reinterpret_cast<const float*>(bg_);
+    if (src->width == 0 || src->height == 0) border = SAMPLE_COLOUR;
+
+    ImageBase *dst = image_alloc(out_width, out_height, src->channels(), src->hasAlpha());
+    switch (src->channels()) {
+        case 1: warp_n<1>(src, inv, dst, filter, border, bg); break;
+        case 2: warp_n<2>(src, inv, dst, filter, border, bg); break;
+        case 3: warp_n<3>(src, inv, dst, filter, border, bg); break;
+        case 4: warp_n<4>(src, inv, dst, filter, border, bg); break;
+        default:
+        delete dst;
+        EXCEPTEX << "Unsupported number of channels: " << int(src->channels()) << ENDL;
+    }
+    return dst;
+}
@@ -0,0 +1,38 @@
+/* Copyright (c) David Cunningham and the Grit Game Engine project 2015
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef WARP_H
+#define WARP_H
+
+#include "image.h"
+#include "sample.h"
+
+/** Projective transformation of the image.  The 3x3 matrix m (row-major) maps homogeneous pixel
+ * coordinates in src to those in an out_width by out_height result, so an affine transform has
+ * 0 0 1 as its bottom row.  Each output pixel centre is mapped back through the inverse and src
+ * sampled there with the given filter; border says what is read outside src, and bg is the
+ * colour used for SAMPLE_COLOUR and for output pixels that map to no point of src (beyond the
+ * horizon of a perspective warp).  m may be scaled by any non-zero factor, negative included.
+ * Throws if m is singular. */
+ImageBase *warp (const ImageBase *src, const double *m, uimglen_t out_width, uimglen_t out_height,
+                 SampleFilter filter, SampleBorder border, const ColourBase *bg);
+
+#endif